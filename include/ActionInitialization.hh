@@ -1,7 +1,16 @@
 #ifndef ACTIONINITIALIZATION_H_
 #define ACTIONINITIALIZATION_H_
 
+#include "Checkpoint.hh"
+#include "CoincidenceTrigger.hh"
+#include "ColumnarOutput.hh"
 #include "DetectorConstruction.hh"
+#include "EventSeeder.hh"
+#include "PMTResponse.hh"
+#include "PrimaryLibrary.hh"
+#include "ProgressLogger.hh"
+#include "StackingPolicy.hh"
+#include "VoxelScoring.hh"
 #include <G4VUserActionInitialization.hh>
 #include <globals.hh>
 
@@ -17,6 +26,15 @@ public:
 
 private:
   DetectorConstruction* fDetectorConstruction;
+  StackingPolicy fStackingPolicy; // shared by the workers' stacking actions
+  EventSeeder fEventSeeder;
+  ProgressLogger* fProgressLogger; // written by every thread
+  ColumnarOutput fColumnarOutput;
+  Checkpoint* fCheckpoint; // updated by every writer thread
+  CoincidenceTrigger fTrigger;
+  PMTResponse fPMTResponse;
+  VoxelScoring fVoxelScoring; // merges the scorers of the threads
+  PrimaryLibrary fPrimaryLibrary; // written and read by every thread
 };
 
 #endif // ACTIONINITIALIZATION_H_
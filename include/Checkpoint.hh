@@ -0,0 +1,118 @@
+#ifndef CHECKPOINT_H_
+#define CHECKPOINT_H_
+
+#include "ColumnarFormat.hh"
+
+#include <globals.hh>
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+class EventSeeder;
+class G4GenericMessenger;
+
+// Periodic checkpoints of a run, from which a crashed run is resumed.
+//
+// Events are reseeded from (seed, run index, event index) by EventSeeder,
+// so a checkpoint needs no engine state: it holds these settings, the
+// events whose hits are in columnar blocks already flushed to the files
+// or that failed the trigger, the trigger counters of these events and
+// the block index of every file up to there. The writer threads
+// report each block, whose events are merged into ranges of done events,
+// and at most once per interval the one that reports syncs the files and
+// writes the checkpoint without holding the lock.
+//
+// /muon_lab/checkpoint/resume closes the files of the checkpoint with
+// their index, so they are readable with everything they held, and runs
+// the events that are missing with a _resume<k> suffix on the outputs.
+class Checkpoint {
+public:
+  explicit Checkpoint(EventSeeder* eventSeeder);
+  ~Checkpoint();
+
+  inline G4bool IsEnabled() const { return fEnabled; }
+
+  // On the master around every run
+  void BeginRun(G4int runID, G4int nEvents);
+  void EndRun();
+
+  // From the threads writing columnar files: the ID of the file, -1
+  // without checkpoints. end is the end of its header.
+  G4int AddFile(const G4String& path, int fd, u64 end);
+  // After the block is written and flushed, from the writer thread, with
+  // the events rejected by the trigger since the previous one. entry is
+  // nullptr when all the events were rejected.
+  void BlockWritten(G4int file, const columnar::BlockIndexEntry* entry,
+                    u64 end, const std::vector<i64>& events,
+                    const std::vector<i64>& rejected, G4long aborted);
+  // Before the file is closed
+  void RemoveFile(G4int file);
+
+  void Resume(const G4String& fileName);
+
+private:
+  // First and last event index of consecutive done events
+  using Range = std::pair<i64, i64>;
+
+  // A columnar file as far as the checkpoint knows it
+  struct File {
+    G4String path;
+    int fd;  // -1 once closed or from an earlier run
+    u64 end; // end of the last block
+    std::vector<columnar::BlockIndexEntry> blocks;
+  };
+
+  void DefineCommands();
+
+  // Called with fMutex held, which is released during the I/O
+  void Write(std::unique_lock<std::mutex>& lock);
+  G4String Format() const;
+  G4bool IsComplete() const;
+
+  // Ranges of sorted events, and their union with sorted disjoint ranges
+  static std::vector<Range> ToRanges(std::vector<i64> events);
+  static void AddRanges(std::vector<Range>& done,
+                        const std::vector<Range>& ranges);
+
+  static G4bool Repair(const File& file);
+
+  EventSeeder* fEventSeeder;
+  G4GenericMessenger* fMessenger;
+
+  G4bool fEnabled;
+  G4String fFileName;
+  G4double fInterval;
+
+  std::mutex fMutex;
+  std::condition_variable fWriteDone;
+  G4bool fWriting; // a thread syncs the files and writes a checkpoint
+  std::chrono::steady_clock::time_point fLastWrite;
+  G4int fWrites;        // checkpoints of this run
+  G4double fWriteTime;  // seconds spent writing them
+  G4bool fWriteFailed;
+
+  // The run being checkpointed
+  G4bool fActive;
+  G4bool fResuming; // the next run resumes a checkpoint
+  G4bool fResumed;  // the run resumes a checkpoint
+  G4long fUserSeed; // seeder settings restored after a resumed run
+  G4int fUserRunIndex;
+  G4long fSeed;
+  G4int fRunIndex;
+  G4long fEventOffset;
+  G4int fNEvents;
+  G4int fResumes;
+  G4long fAccepted; // trigger counters of the done events
+  G4long fRejected;
+  G4long fAborted;
+  G4String fOutputName;   // columnar file name of the first attempt
+  G4String fAnalysisName; // analysis file name of the first attempt
+  G4String fScoringName;  // voxel scoring file name of the first attempt
+  std::vector<Range> fDone; // sorted and disjoint
+  std::vector<File> fFiles;
+};
+
+#endif // CHECKPOINT_H_
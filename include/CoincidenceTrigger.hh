@@ -0,0 +1,55 @@
+#ifndef COINCIDENCETRIGGER_H_
+#define COINCIDENCETRIGGER_H_
+
+#include <globals.hh>
+
+#include <map>
+#include <vector>
+
+class G4GenericMessenger;
+class ScintillatorSD;
+
+// Coincidence trigger on the scintillator channels.
+//
+// An event is accepted when every required channel has at least its
+// threshold of (unweighted) energy deposit and the first deposits of these
+// channels are all within the time window. Rejected events are counted but
+// not written. With early abort the tracking action stops an event as soon
+// as the energy still carried by its particles cannot bring a required
+// channel to its threshold any more.
+//
+// Set on the master with /muon_lab/trigger/ and read by the workers.
+class CoincidenceTrigger {
+public:
+  CoincidenceTrigger();
+  ~CoincidenceTrigger();
+
+  inline G4bool IsEnabled() const { return fEnabled; }
+  inline G4bool IsEarlyAbortEnabled() const { return fEnabled && fEarlyAbort; }
+
+  G4bool Accept(const ScintillatorSD& sd) const;
+
+  // False once budget more energy cannot make the event pass
+  G4bool IsReachable(const ScintillatorSD& sd, G4double budget) const;
+
+  // Space separated channels
+  void SetChannels(const G4String& channels);
+  // <channel|all> <value> <unit>
+  void SetThreshold(const G4String& setting);
+
+private:
+  void DefineCommands();
+
+  G4double GetThreshold(G4int channel) const;
+
+  G4GenericMessenger* fMessenger;
+
+  G4bool fEnabled;
+  G4bool fEarlyAbort;
+  G4double fWindow;
+  std::vector<G4int> fChannels;
+  G4double fDefaultThreshold;
+  std::map<G4int, G4double> fThresholds;
+};
+
+#endif // COINCIDENCETRIGGER_H_
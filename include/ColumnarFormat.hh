@@ -0,0 +1,325 @@
+#ifndef COLUMNARFORMAT_H_
+#define COLUMNARFORMAT_H_
+
+// On-disk layout of the columnar hit files, shared by ColumnarWriter and
+// the standalone tools. Only depends on pft.hpp, not on Geant4.
+//
+// A file is written by one thread for one run:
+//
+//   FileHeader
+//   ColumnDesc[nColumns]            selected Particles_t fields
+//   block 0 .. block n-1
+//   BlockIndexEntry[nBlocks]        footer index
+//   Trailer                         last 24 bytes of the file
+//
+// and every block is
+//
+//   BlockHeader
+//   i64 event[nEvents]              event index (EventSeeder)
+//   f64 weight[nEvents]             primary vertex weight
+//   u64 hitEnd[nEvents]             end of the event's rows in the block
+//   column 0 .. column c-1          nRows values each, padded to 8 bytes
+//
+// Everything is little endian and 8-byte aligned, so a mapped file can be
+// read in place.
+
+#include "pft.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace columnar {
+
+constexpr char kFileMagic[8]    = {'M', 'L', 'C', 'O', 'L', 'S', '0', '1'};
+constexpr char kTrailerMagic[8] = {'M', 'L', 'C', 'O', 'L', 'E', 'N', 'D'};
+constexpr u32 kBlockMagic       = 0x4b4c4231; // "1BLK"
+constexpr u32 kVersion          = 1;
+
+enum ColumnType : u32 { kInt32 = 1, kFloat64 = 2 };
+
+struct FileHeader {
+  char magic[8];
+  u32 version;
+  u32 nColumns;
+  i32 run;
+  i32 thread;
+  u64 reserved;
+};
+
+struct ColumnDesc {
+  char name[16];
+  u32 type;  // ColumnType
+  u32 field; // index in kFields
+};
+
+struct BlockHeader {
+  u32 magic;
+  u32 nColumns;
+  u64 nRows;
+  u64 nEvents;
+  u64 size; // bytes of the block, header included
+};
+
+struct BlockIndexEntry {
+  u64 offset;
+  u64 nRows;
+  u64 nEvents;
+  i64 firstEvent;
+};
+
+struct Trailer {
+  u64 nBlocks;
+  u64 indexOffset;
+  char magic[8];
+};
+
+static_assert(sizeof(FileHeader) % 8 == 0 && sizeof(ColumnDesc) % 8 == 0 &&
+                  sizeof(BlockHeader) % 8 == 0 &&
+                  sizeof(BlockIndexEntry) % 8 == 0 && sizeof(Trailer) == 24,
+              "columnar records must keep 8-byte alignment");
+
+inline constexpr u64 Padded(u64 bytes) { return (bytes + 7) & ~u64(7); }
+
+inline constexpr std::size_t TypeSize(u32 type)
+{
+  return type == kInt32 ? sizeof(i32) : sizeof(f64);
+}
+
+// The Particles_t fields, in the order of the struct
+struct Field {
+  const char* name;
+  ColumnType type;
+  std::vector<i32> pft::Particles_t::*i32Column;
+  std::vector<f64> pft::Particles_t::*f64Column;
+};
+
+using Particles = pft::Particles_t;
+constexpr Field kFields[] = {
+    {"det_id", kInt32, &Particles::det_id, nullptr},
+    {"pdg", kInt32, &Particles::pdg, nullptr},
+    {"parent_id", kInt32, &Particles::parent_id, nullptr},
+    {"trid", kInt32, &Particles::trid, nullptr},
+    {"n_secondaries", kInt32, &Particles::n_secondaries, nullptr},
+    {"times", kFloat64, nullptr, &Particles::times},
+    {"edep", kFloat64, nullptr, &Particles::edep},
+    {"energy", kFloat64, nullptr, &Particles::energy},
+    {"posX", kFloat64, nullptr, &Particles::posX},
+    {"posY", kFloat64, nullptr, &Particles::posY},
+    {"posZ", kFloat64, nullptr, &Particles::posZ},
+    {"theta", kFloat64, nullptr, &Particles::theta},
+    {"phi", kFloat64, nullptr, &Particles::phi},
+    {"trlen", kFloat64, nullptr, &Particles::trlen},
+    {"weight", kFloat64, nullptr, &Particles::weight},
+};
+constexpr std::size_t kNFields = sizeof(kFields) / sizeof(kFields[0]);
+
+// Index of a field by name, kNFields if there is none
+inline std::size_t FindField(const std::string& name)
+{
+  for (std::size_t i = 0; i < kNFields; ++i) {
+    if (name == kFields[i].name) {
+      return i;
+    }
+  }
+  return kNFields;
+}
+
+inline const void* ColumnData(const pft::Particles_t& par, std::size_t field)
+{
+  const auto& f = kFields[field];
+  return f.type == kInt32 ? static_cast<const void*>((par.*f.i32Column).data())
+                          : static_cast<const void*>((par.*f.f64Column).data());
+}
+
+inline std::size_t ColumnSize(const pft::Particles_t& par, std::size_t field)
+{
+  const auto& f = kFields[field];
+  return f.type == kInt32 ? (par.*f.i32Column).size()
+                          : (par.*f.f64Column).size();
+}
+
+// Append n values read from data to a column of par
+inline void AppendColumn(pft::Particles_t& par, std::size_t field,
+                         const void* data, std::size_t n)
+{
+  const auto& f = kFields[field];
+  if (f.type == kInt32) {
+    const auto* values = static_cast<const i32*>(data);
+    (par.*f.i32Column).insert((par.*f.i32Column).end(), values, values + n);
+  } else {
+    const auto* values = static_cast<const f64*>(data);
+    (par.*f.f64Column).insert((par.*f.f64Column).end(), values, values + n);
+  }
+}
+
+// Read-only memory mapped view of a columnar file
+class MappedFile {
+public:
+  MappedFile() = default;
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+  ~MappedFile() { Close(); }
+
+  // False if the file cannot be mapped or is not a complete columnar file
+  bool Open(const std::string& path)
+  {
+    Close();
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      return false;
+    }
+    struct stat st;
+    if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+      fSize = static_cast<std::size_t>(st.st_size);
+      void* data = ::mmap(nullptr, fSize, PROT_READ, MAP_PRIVATE, fd, 0);
+      fData      = data == MAP_FAILED ? nullptr : static_cast<const u8*>(data);
+    }
+    ::close(fd);
+    if (!fData || !Validate()) {
+      Close();
+      return false;
+    }
+    return true;
+  }
+
+  void Close()
+  {
+    if (fData) {
+      ::munmap(const_cast<u8*>(fData), fSize);
+    }
+    fData = nullptr;
+    fSize = 0;
+  }
+
+  const FileHeader& Header() const { return *At<FileHeader>(0); }
+  const ColumnDesc* Columns() const
+  {
+    return At<ColumnDesc>(sizeof(FileHeader));
+  }
+  const Trailer& GetTrailer() const
+  {
+    return *At<Trailer>(fSize - sizeof(Trailer));
+  }
+  u64 NumBlocks() const { return GetTrailer().nBlocks; }
+  const BlockIndexEntry& Index(u64 block) const
+  {
+    return At<BlockIndexEntry>(GetTrailer().indexOffset)[block];
+  }
+
+  // Pointers into one block
+  struct Block {
+    const BlockHeader* header;
+    const i64* event;
+    const f64* weight;
+    const u64* hitEnd;
+    std::vector<const void*> columns; // in the order of Columns()
+  };
+
+  Block GetBlock(u64 block) const
+  {
+    Block b;
+    u64 offset = Index(block).offset;
+    b.header   = At<BlockHeader>(offset);
+    offset += sizeof(BlockHeader);
+    const u64 nEvents = b.header->nEvents;
+    b.event           = At<i64>(offset);
+    b.weight          = At<f64>(offset + nEvents * sizeof(i64));
+    b.hitEnd          = At<u64>(offset + nEvents * (sizeof(i64) + sizeof(f64)));
+    offset += nEvents * (sizeof(i64) + sizeof(f64) + sizeof(u64));
+    for (u32 c = 0; c < Header().nColumns; ++c) {
+      b.columns.push_back(fData + offset);
+      offset += Padded(b.header->nRows * TypeSize(Columns()[c].type));
+    }
+    return b;
+  }
+
+private:
+  template <typename T>
+  const T* At(u64 offset) const
+  {
+    return reinterpret_cast<const T*>(fData + offset);
+  }
+
+  bool Validate() const
+  {
+    if (fSize < sizeof(FileHeader) + sizeof(Trailer) ||
+        std::memcmp(Header().magic, kFileMagic, 8) != 0 ||
+        Header().version != kVersion ||
+        std::memcmp(GetTrailer().magic, kTrailerMagic, 8) != 0) {
+      return false;
+    }
+    const u64 indexEnd =
+        GetTrailer().indexOffset + NumBlocks() * sizeof(BlockIndexEntry);
+    const u64 columnsEnd =
+        sizeof(FileHeader) + Header().nColumns * sizeof(ColumnDesc);
+    if (indexEnd + sizeof(Trailer) != fSize ||
+        columnsEnd > GetTrailer().indexOffset) {
+      return false;
+    }
+    for (u32 c = 0; c < Header().nColumns; ++c) {
+      if (Columns()[c].field >= kNFields ||
+          (Columns()[c].type != kInt32 && Columns()[c].type != kFloat64)) {
+        return false;
+      }
+    }
+    for (u64 i = 0; i < NumBlocks(); ++i) {
+      if (!ValidateBlock(Index(i).offset)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // The readers trust the sizes and the hit ranges of the blocks, so they
+  // must describe exactly the bytes the block has
+  bool ValidateBlock(u64 offset) const
+  {
+    const u64 end = GetTrailer().indexOffset;
+    if (offset % 8 != 0 || offset > end || end - offset < sizeof(BlockHeader)) {
+      return false;
+    }
+    const auto& header = *At<BlockHeader>(offset);
+    const u64 available = end - offset - sizeof(BlockHeader);
+    const u64 eventBytes = sizeof(i64) + sizeof(f64) + sizeof(u64);
+    // Bounded first, so that the size below cannot overflow
+    if (header.magic != kBlockMagic || header.nColumns != Header().nColumns ||
+        header.nEvents == 0 || header.nEvents > available / eventBytes ||
+        header.nRows > available) {
+      return false;
+    }
+    u64 size = sizeof(BlockHeader) + header.nEvents * eventBytes;
+    for (u32 c = 0; c < header.nColumns; ++c) {
+      size += Padded(header.nRows * TypeSize(Columns()[c].type));
+    }
+    if (size != header.size || size - sizeof(BlockHeader) > available) {
+      return false;
+    }
+
+    const auto* hitEnd =
+        At<u64>(offset + sizeof(BlockHeader) +
+                header.nEvents * (sizeof(i64) + sizeof(f64)));
+    u64 previous = 0;
+    for (u64 e = 0; e < header.nEvents; ++e) {
+      if (hitEnd[e] < previous) {
+        return false;
+      }
+      previous = hitEnd[e];
+    }
+    return previous == header.nRows;
+  }
+
+  const u8* fData   = nullptr;
+  std::size_t fSize = 0;
+};
+
+} // namespace columnar
+
+#endif // COLUMNARFORMAT_H_
@@ -0,0 +1,50 @@
+#ifndef COLUMNAROUTPUT_H_
+#define COLUMNAROUTPUT_H_
+
+#include <globals.hh>
+
+#include <vector>
+
+class G4GenericMessenger;
+
+// Settings of the columnar hit files, see ColumnarFormat.hh.
+//
+// Every thread that simulates events writes <fileName>_run<R>_t<T>.mlc
+// with the selected Particles_t columns. Set on the master with the
+// /muon_lab/output/ commands and read by the workers' run actions. The
+// hits can be left out of the ROOT ntuple, which is filled on the event
+// loop, when the columnar files are enough.
+class ColumnarOutput {
+public:
+  ColumnarOutput();
+  ~ColumnarOutput();
+
+  inline G4bool IsEnabled() const { return fEnabled; }
+  inline G4int GetBlockRows() const { return fBlockRows; }
+  inline G4int GetBlockEvents() const { return fBlockEvents; }
+  inline G4int GetBuffers() const { return fBuffers; }
+  inline G4bool IsNtupleEnabled() const { return fNtuple; }
+
+  // Indices in columnar::kFields of the selected columns
+  inline const std::vector<std::size_t>& GetFields() const { return fFields; }
+
+  G4String GetPath(G4int run, G4int thread) const;
+
+  // Space separated field names, or "all"
+  void SetColumns(const G4String& columns);
+
+private:
+  void DefineCommands();
+
+  G4GenericMessenger* fMessenger;
+
+  G4bool fEnabled;
+  G4String fFileName;
+  G4int fBlockRows;
+  G4int fBlockEvents;
+  G4int fBuffers;
+  G4bool fNtuple;
+  std::vector<std::size_t> fFields;
+};
+
+#endif // COLUMNAROUTPUT_H_
@@ -0,0 +1,99 @@
+#ifndef COLUMNARWRITER_H_
+#define COLUMNARWRITER_H_
+
+#include "ColumnarFormat.hh"
+#include "pft.hpp"
+
+#include <globals.hh>
+
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class Checkpoint;
+
+// Writes the hits of one thread to a columnar file, see ColumnarFormat.hh.
+//
+// Events are appended to the block being filled. A full block is handed to
+// a writer thread through a bounded queue and filling goes on in the next
+// free buffer, so the event loop only waits for the disk when every buffer
+// is queued. The footer index is written by Close.
+class ColumnarWriter {
+public:
+  // Output pipeline counters of one run
+  struct Stats {
+    G4int blocks       = 0;  // blocks handed to the writer thread
+    G4int stalls       = 0;  // hand-offs that waited for a free buffer
+    G4double stallTime = 0.; // seconds the event loop waited
+    G4int queueDepth   = 0;  // sum of the queue depths seen at hand-off
+  };
+
+  ColumnarWriter();
+  ~ColumnarWriter();
+
+  // A block is closed at blockRows hits or blockEvents events. nBuffers
+  // >= 2 blocks are allocated, 2 is double buffering. With an enabled
+  // checkpoint every block is flushed and reported to it.
+  G4bool Open(const G4String& path, G4int run, G4int thread,
+              const std::vector<std::size_t>& fields, std::size_t blockRows,
+              std::size_t blockEvents, std::size_t nBuffers,
+              Checkpoint* checkpoint);
+  void Close();
+
+  inline G4bool IsOpen() const { return fFile != nullptr; }
+  inline const Stats& GetStats() const { return fStats; }
+
+  void AddEvent(G4long eventIndex, G4double weight,
+                const pft::Particles_t& hits);
+  // Events that failed the trigger, only reported to the checkpoint with
+  // the block, which counts them as done
+  void AddRejected(G4long eventIndex, G4bool aborted);
+
+private:
+  struct Batch {
+    pft::Particles_t hits;
+    std::vector<i64> events;
+    std::vector<f64> weights;
+    std::vector<u64> hitEnd;
+    std::vector<i64> rejected;
+    G4long aborted = 0; // of the rejected events
+  };
+
+  void Submit(G4bool wait);
+  void Run(); // writer thread
+  void WriteBlock(Batch& batch);
+  void Write(const void* data, std::size_t bytes);
+
+  std::FILE* fFile;
+  G4String fPath;
+  std::vector<char> fBuffer; // stdio buffer, sized for large writes
+  G4bool fWriteFailed;
+  Checkpoint* fCheckpoint;
+  G4int fCheckpointFile;
+
+  std::vector<std::size_t> fFields;
+  std::size_t fBlockRows;
+  std::size_t fBlockEvents;
+
+  // Owned by the writer thread while the file is open
+  u64 fOffset;
+  std::vector<columnar::BlockIndexEntry> fIndex;
+
+  std::vector<Batch> fBatches;
+  Batch* fFilling; // owned by the event loop
+
+  std::thread fWriter;
+  std::mutex fMutex;
+  std::condition_variable fFullCondition;
+  std::condition_variable fFreeCondition;
+  std::deque<Batch*> fFull;
+  std::vector<Batch*> fFree;
+  G4bool fStop;
+
+  Stats fStats;
+};
+
+#endif // COLUMNARWRITER_H_
@@ -0,0 +1,64 @@
+#ifndef COSMICMUONSPECTRUM_H_
+#define COSMICMUONSPECTRUM_H_
+
+#include <globals.hh>
+
+#include <functional>
+#include <vector>
+
+/// Sea-level cosmic muon spectrum in (energy, zenith angle).
+///
+/// Uses the Gaisser parametrization with the Guan et al. (arXiv:1509.06176)
+/// correction for large zenith angles, weighted by cos(theta) for the flux
+/// through a horizontal plane. The spectrum is tabulated once on a
+/// (log E, cos theta) grid and sampled in O(1) through a Walker alias table.
+class CosmicMuonSpectrum {
+public:
+  CosmicMuonSpectrum();
+  ~CosmicMuonSpectrum();
+
+  using Importance = std::function<G4double(G4double, G4double)>;
+
+  // Tabulate the spectrum between the given kinetic energies and
+  // cos(theta) range for a particle of the given mass, sampled in
+  // proportion to the spectrum times the importance if one is given
+  void Build(G4double ekinMin, G4double ekinMax, G4double cosThetaMin,
+             G4double cosThetaMax, G4double mass, G4int nEnergyBins,
+             G4int nAngleBins, const Importance& importance = nullptr);
+
+  // Draw a kinetic energy and cos(theta), O(1) per call. Returns the
+  // weight of the draw, 1 without importance.
+  G4double Sample(G4double& ekin, G4double& cosTheta) const;
+
+  // Differential intensity dI/dE dOmega for total energy E at cos(theta)
+  static G4double Intensity(G4double energy, G4double cosTheta);
+
+  // Integrated flux over the tabulated range, in the units of Intensity
+  inline G4double GetIntegral() const { return fIntegral; }
+
+  // Fraction of the draws the importance gave to bins it favours
+  inline G4double GetBiasedFraction() const { return fBiasedFraction; }
+
+  inline G4bool IsBuilt() const { return !fProb.empty(); }
+
+private:
+  void BuildAliasTable(const std::vector<G4double>& weights);
+
+  G4double fMass;
+  G4double fLogEmin;
+  G4double fDLogE;
+  G4double fCosMin;
+  G4double fDCos;
+  G4int fNAngleBins;
+  G4double fIntegral;
+  G4double fBiasedFraction;
+
+  // Weight of the draws of each bin, empty without importance
+  std::vector<G4double> fWeight;
+
+  // Walker alias table over the flattened (energy, angle) bins
+  std::vector<G4double> fProb;
+  std::vector<G4int> fAlias;
+};
+
+#endif // COSMICMUONSPECTRUM_H_
@@ -0,0 +1,37 @@
+#ifndef DECAYBIASING_H_
+#define DECAYBIASING_H_
+
+#include <globals.hh>
+
+class G4GenericMessenger;
+
+// Decay in flight enrichment of the muons in chosen volumes.
+//
+// The muon decay is wrapped by G4GenericBiasingPhysics in every physics
+// profile. Inside the volumes of /muon_lab/bias/volumes, the Absorber
+// region by default, a DecayBiasingOperator multiplies the decay
+// cross-section of the muons by /muon_lab/bias/decayFactor, the weights
+// of the muon and of its decay products compensate for it. A factor of 1
+// leaves the decay analog.
+//
+// Set on the master with /muon_lab/bias/ and read by the workers.
+class DecayBiasing {
+public:
+  DecayBiasing();
+  ~DecayBiasing();
+
+  inline G4double GetDecayFactor() const { return fDecayFactor; }
+
+  // Attach an operator of this thread to the volumes
+  void Attach() const;
+
+private:
+  void DefineCommands();
+
+  G4GenericMessenger* fMessenger;
+
+  G4double fDecayFactor;
+  G4String fVolumes; // space separated region or logical volume names
+};
+
+#endif // DECAYBIASING_H_
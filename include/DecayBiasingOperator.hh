@@ -0,0 +1,54 @@
+#ifndef DECAYBIASINGOPERATOR_H_
+#define DECAYBIASINGOPERATOR_H_
+
+#include <G4VBiasingOperator.hh>
+#include <globals.hh>
+
+#include <map>
+
+class DecayBiasing;
+class G4BOptnChangeCrossSection;
+
+// Scales the decay cross-section of the muons in the volumes it is attached
+// to, as G4BOptrChangeCrossSection does for every process. One instance
+// per thread, see DecayBiasing.
+class DecayBiasingOperator : public G4VBiasingOperator {
+public:
+  DecayBiasingOperator(const DecayBiasing* settings);
+  virtual ~DecayBiasingOperator();
+
+  virtual void StartRun();
+
+private:
+  virtual G4VBiasingOperation*
+  ProposeOccurenceBiasingOperation(const G4Track* track,
+                                   const G4BiasingProcessInterface* process);
+  virtual G4VBiasingOperation*
+  ProposeFinalStateBiasingOperation(const G4Track*,
+                                    const G4BiasingProcessInterface*)
+  {
+    return nullptr;
+  }
+  virtual G4VBiasingOperation*
+  ProposeNonPhysicsBiasingOperation(const G4Track*,
+                                    const G4BiasingProcessInterface*)
+  {
+    return nullptr;
+  }
+
+  using G4VBiasingOperator::OperationApplied;
+  virtual void OperationApplied(const G4BiasingProcessInterface* process,
+                                G4BiasingAppliedCase biasingCase,
+                                G4VBiasingOperation* occurenceOperation,
+                                G4double weightForOccurence,
+                                G4VBiasingOperation* finalStateOperation,
+                                const G4VParticleChange* particleChange);
+
+  const DecayBiasing* fSettings;
+
+  // One operation per wrapped muon decay process
+  std::map<const G4BiasingProcessInterface*, G4BOptnChangeCrossSection*>
+      fOperations;
+};
+
+#endif // DECAYBIASINGOPERATOR_H_
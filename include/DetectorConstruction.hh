@@ -1,12 +1,22 @@
 #ifndef DETECTORCONSTRUCTION_H_
 #define DETECTORCONSTRUCTION_H_
 
+#include "DecayBiasing.hh"
+#include "GeometryConfig.hh"
+#include "RegionSettings.hh"
+#include "ScintillatorHitFilter.hh"
+#include "ScintillatorOpticalModel.hh"
+
 #include <G4Material.hh>
 #include <G4OpticalSurface.hh>
 #include <G4VUserDetectorConstruction.hh>
 #include <globals.hh>
 
+#include <vector>
+
+class G4LogicalVolume;
 class G4VPhysicalVolume;
+class G4VisAttributes;
 
 /// Detector construction class to define materials and geometry.
 
@@ -18,13 +28,28 @@ public:
   virtual G4VPhysicalVolume* Construct();
   virtual void ConstructSDandField(); // construct Sensitive Detector
 
+  inline const ScintillatorOpticalModel& GetOpticalModel() const
+  {
+    return fOpticalModel;
+  }
+
 private:
   // methods
   void DefineMaterials();
   G4VPhysicalVolume* DefineVolumes();
 
+  // Place the planes of paddles of an array, returns the plane volume
+  G4LogicalVolume* BuildArray(const GeometryConfig::Volume& volume,
+                              G4LogicalVolume* motherLV,
+                              G4VisAttributes* paddleVis,
+                              std::vector<G4VPhysicalVolume*>& placements);
+
   // data members
-  G4bool fCheckOverlaps;
+  GeometryConfig fGeometry;
+  ScintillatorHitFilter fHitFilter; // shared by the workers' detectors
+  ScintillatorOpticalModel fOpticalModel;
+  RegionSettings fRegionSettings;
+  DecayBiasing fDecayBiasing;
 };
 
 #endif // DETECTORCONSTRUCTION_H_
@@ -1,38 +1,92 @@
 #ifndef EVENTACTION_H_
 #define EVENTACTION_H_
 
+#include "CoincidenceTrigger.hh"
+#include "ColumnarWriter.hh"
+#include "EventSeeder.hh"
+#include "PMTDigitizer.hh"
+#include "PMTResponse.hh"
+#include "ProgressLogger.hh"
 #include "ScintillatorHit.hh"
 #include "pft.hpp"
 
 #include <G4SystemOfUnits.hh>
-#include <G4THitsMap.hh>
 #include <G4UserEventAction.hh>
 #include <globals.hh>
 
+#include <vector>
+
+class RunAction;
+class ScintillatorOpticalModel;
+class ScintillatorSD;
+class TrackingAction;
+
 // Event action class
 class EventAction : public G4UserEventAction {
 public:
-  EventAction();
+  EventAction(const EventSeeder* eventSeeder, ProgressLogger* progressLogger,
+              const CoincidenceTrigger* trigger,
+              const PMTResponse* pmtResponse);
   virtual ~EventAction();
 
+  // Digitizer settings of the run, which needs the fast optical model
+  void BeginOfRun(const ScintillatorOpticalModel& opticalModel);
+
   virtual void BeginOfEventAction(const G4Event* event);
   virtual void EndOfEventAction(const G4Event* event);
 
+  // Counts the trigger decisions
+  inline void SetRunAction(RunAction* runAction) { fRunAction = runAction; }
+  // Given the primaries of every event, for the trigger early abort
+  inline void SetTrackingAction(TrackingAction* trackingAction)
+  {
+    fTrackingAction = trackingAction;
+  }
+  inline void SetWeightColumnID(G4int id) { fWeightColumnID = id; }
+  inline void SetEventColumnIDs(G4int runID, G4int eventID)
+  {
+    fRunColumnID   = runID;
+    fEventColumnID = eventID;
+  }
+  // First of the run, event, weight and windowStart columns of the digits
+  inline void SetDigitColumnID(G4int id) { fDigitColumnID = id; }
+  // Hits are also written here when set, nullptr for the ntuple only
+  inline void SetColumnarWriter(ColumnarWriter* writer)
+  {
+    fColumnarWriter = writer;
+  }
+  inline void SetNtupleEnabled(G4bool enabled) { fNtupleEnabled = enabled; }
+  // The digits replace the hits unless they are kept
+  inline G4bool IsWritingHits() const
+  {
+    return !fPMTResponse->IsEnabled() || fPMTResponse->IsKeepingHits();
+  }
+
   pft::Particles_t fParticles;
+  // Scintillators with photoelectrons and their number, in channel order
+  std::vector<G4int> fPEChannels;
+  std::vector<G4int> fPhotoelectrons;
+  PMTDigits fDigits;
 
 private:
-  G4THitsMap<G4double>* GetHitsCollection(G4int hcID,
-                                          const G4Event* event) const;
-  G4double GetSum(G4THitsMap<G4double>* hitsMap) const;
-  void PrintEventStatistics(G4int i, G4double absoEdep) const;
-
-  void Populate(pft::Particles_t& par,
-                const ScintillatorHitsCollection* ScintHC);
-
-  G4int fScintillator0EdepID;
-  G4int fScintillator1EdepID;
-  G4int fScintillator2EdepID;
-  G4int fScintillatorCollID;
+  void LogEvent(const G4Event* event) const;
+
+  void Populate(pft::Particles_t& par, ScintillatorHitBuffer& hitBuffer);
+
+  const EventSeeder* fEventSeeder;
+  ProgressLogger* fProgressLogger;
+  const CoincidenceTrigger* fTrigger;
+  const PMTResponse* fPMTResponse;
+  PMTDigitizer* fDigitizer; // owned by G4DigiManager
+  RunAction* fRunAction;
+  TrackingAction* fTrackingAction;
+  ColumnarWriter* fColumnarWriter;
+  G4bool fNtupleEnabled;
+  ScintillatorSD* fScintillatorSD;
+  G4int fWeightColumnID;
+  G4int fRunColumnID;
+  G4int fEventColumnID;
+  G4int fDigitColumnID;
 };
 
 #endif // EVENTACTION_H_
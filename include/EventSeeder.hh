@@ -0,0 +1,65 @@
+#ifndef EVENTSEEDER_H_
+#define EVENTSEEDER_H_
+
+#include <globals.hh>
+
+#include <cstdint>
+#include <vector>
+
+class G4GenericMessenger;
+
+// Derives the random seeds of every event from (run seed, run, event).
+//
+// The engine of the thread is reseeded at the start of each event with a
+// SplitMix64 hash of the three numbers, so an event's random stream does
+// not depend on which thread simulates it or on how many events came
+// before on that thread. Any event of a production file can be simulated
+// again alone with the same seed, runIndex and eventOffset.
+//
+// Set on the master with /muon_lab/random/ and read by the workers.
+class EventSeeder {
+public:
+  EventSeeder();
+  ~EventSeeder();
+
+  // Indices recorded with the event, from the Geant4 run and event IDs
+  inline G4int GetRunIndex(G4int runID) const
+  {
+    return fRunIndex >= 0 ? fRunIndex : runID;
+  }
+  inline G4long GetEventIndex(G4int eventID) const
+  {
+    return fEventList.empty() ? fEventOffset + eventID : fEventList[eventID];
+  }
+
+  // Reseed the engine of the calling thread for this event
+  void SeedEvent(G4int runID, G4int eventID) const;
+
+  inline G4long GetSeed() const { return fSeed; }
+  inline G4long GetEventOffset() const { return fEventOffset; }
+
+  inline void SetSeed(G4long seed) { fSeed = seed; }
+  inline void SetRunIndex(G4int runIndex) { fRunIndex = runIndex; }
+  inline void SetEventOffset(G4long offset) { fEventOffset = offset; }
+
+  // Event indices of the next runs instead of the offset when not empty,
+  // e.g. the events a checkpoint has not seen yet
+  inline void SetEventList(const std::vector<G4long>& events)
+  {
+    fEventList = events;
+  }
+
+  static std::uint64_t SplitMix64(std::uint64_t x);
+
+private:
+  void DefineCommands();
+
+  G4GenericMessenger* fMessenger;
+
+  G4long fSeed;
+  G4int fRunIndex; // negative: the Geant4 run ID
+  G4long fEventOffset;
+  std::vector<G4long> fEventList;
+};
+
+#endif // EVENTSEEDER_H_
@@ -0,0 +1,42 @@
+#ifndef FORKEDRUN_H_
+#define FORKEDRUN_H_
+
+#include "RunAction.hh"
+
+#include <globals.hh>
+
+// Runs the events of a batch job in forked copies of this process.
+//
+// The parent initializes the geometry and builds the physics tables with
+// a run of no events, then forks the workers, which share these tables
+// copy-on-write. Worker i simulates a disjoint range of event indices
+// (/muon_lab/random/eventOffset), so the events are the ones a single
+// process would give, and writes its own files with a _p<i> suffix. The
+// parent collects the exit status, event count and run counters of every
+// worker and prints the summaries of the whole job; a crash only loses the
+// events of that worker.
+//
+// Needs the sequential run manager: threads do not survive a fork.
+class ForkedRun {
+public:
+  explicit ForkedRun(G4int nProcesses);
+  ~ForkedRun();
+
+  // Simulates nEvents in total. Returns the exit code of the calling
+  // process, which is either the parent or a worker.
+  G4int BeamOn(G4long nEvents);
+
+private:
+  // Sent by a worker to the parent when its run is done
+  struct Summary {
+    G4long events;
+    G4double realTime;
+    RunAction::Counters counters;
+  };
+
+  void RunWorker(G4int index, G4long firstEvent, G4long nEvents, int fd);
+
+  G4int fNProcesses;
+};
+
+#endif // FORKEDRUN_H_
@@ -0,0 +1,82 @@
+#ifndef GEOMETRYCONFIG_H_
+#define GEOMETRYCONFIG_H_
+
+#include <globals.hh>
+
+#include <cstdint>
+#include <vector>
+
+class G4GenericMessenger;
+class G4VPhysicalVolume;
+
+// Description of the detector stack, by default the lab setup and
+// otherwise read from a text file with /muon_lab/geometry/file before
+// /run/initialize. One volume per line, lengths are full box sizes and
+// the position is the z of the centre, '#' starts a comment:
+//
+//   world        <material> <x> <y> <z> <unit>
+//   scintillator <channel> <material> <x> <y> <z> <zCentre> <unit>
+//   absorber     <material> <x> <y> <z> <zCentre> <unit>
+//   array        <firstChannel> <material> <planes> <paddles> <x> <y> <z>
+//                <pitch> <zCentre> <unit>
+//
+// An array is a stack of planes, pitch apart in z, of paddles of size
+// (x, y, z) side by side in x. Its paddles are the channels
+// firstChannel + paddle + paddles * plane.
+//
+// The overlap check of a geometry is cached: the hash of every geometry
+// found without overlaps is appended to /muon_lab/geometry/overlapCache
+// and later starts with the same geometry skip the check.
+class GeometryConfig {
+public:
+  enum class Kind { Scintillator, Absorber, Array };
+
+  struct Volume {
+    Kind kind;
+    G4int copyNumber; // channel of a scintillator or of the first paddle of
+                      // an array, index of an absorber
+    G4String material;
+    G4double size[3]; // of a paddle for an array
+    G4double z;
+    G4int planes   = 1;
+    G4int paddles  = 1;
+    G4double pitch = 0.;
+  };
+
+  GeometryConfig();
+  ~GeometryConfig();
+
+  inline const G4String& GetWorldMaterial() const { return fWorldMaterial; }
+  inline const G4double* GetWorldSize() const { return fWorldSize; }
+  inline const std::vector<Volume>& GetVolumes() const { return fVolumes; }
+
+  // Highest scintillator or paddle channel plus one
+  G4int GetNumberOfChannels() const;
+
+  // Replace the stack by the one of the file, kept as it is on errors
+  void Load(const G4String& fileName);
+
+  // Check the placements unless the cache knows this geometry. Returns
+  // false if they overlap.
+  G4bool CheckOverlaps(const std::vector<G4VPhysicalVolume*>& volumes) const;
+
+private:
+  void DefineCommands();
+
+  // Shapes and placements, the materials do not change the overlaps
+  G4String Describe() const;
+  static std::uint64_t Hash(const G4String& text);
+
+  G4bool IsCached(std::uint64_t hash) const;
+
+  G4GenericMessenger* fMessenger;
+
+  G4String fWorldMaterial;
+  G4double fWorldSize[3];
+  std::vector<Volume> fVolumes;
+
+  G4String fCheckOverlaps; // always, cached or never
+  G4String fOverlapCache;
+};
+
+#endif // GEOMETRYCONFIG_H_
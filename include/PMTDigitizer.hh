@@ -0,0 +1,70 @@
+#ifndef PMTDIGITIZER_H_
+#define PMTDIGITIZER_H_
+
+#include "PMTResponse.hh"
+
+#include <G4VDigitizerModule.hh>
+#include <globals.hh>
+
+#include <vector>
+
+class ScintillatorSD;
+
+// Digitized records of one event, one entry per channel that fired.
+// Times are in ns, charges and amplitudes in photoelectron peaks.
+struct PMTDigits {
+  G4double windowStart = 0.; // time of the first sample
+  std::vector<G4int> channel;
+  std::vector<G4double> time;   // leading edge threshold crossing
+  std::vector<G4double> charge; // pulse integral in photoelectrons
+  std::vector<G4double> peak;   // highest sample
+  // Samples of the channels that fired, back to back, when enabled
+  std::vector<float> samples;
+
+  void Clear();
+};
+
+// Turns the photoelectrons of the fast optical model into PMT waveforms
+// and discriminator records, see PMTResponse.
+//
+// The photoelectrons of a channel are histogrammed on the sampling grid
+// with their gains, then convolved with the precomputed single
+// photoelectron kernel: one multiply-add over the contiguous kernel per
+// occupied sample, which the compiler vectorizes. Every worker has its
+// own module, registered with G4DigiManager, which owns it. The records
+// go to digits, owned by the event action.
+class PMTDigitizer : public G4VDigitizerModule {
+public:
+  PMTDigitizer(const PMTResponse* response, PMTDigits* digits);
+  virtual ~PMTDigitizer();
+
+  // Sample the kernel with the settings of the run
+  void BeginOfRun();
+
+  virtual void Digitize();
+
+private:
+  // Adds the kernel scaled by amplitude at each occupied sample
+  void Convolve(const float* input, float* output) const;
+  void Discriminate(G4int channel, const float* samples);
+
+  const PMTResponse* fResponse;
+  ScintillatorSD* fScintillatorSD;
+
+  std::vector<float> fKernel;
+  G4double fKernelArea; // in samples
+  G4int fNSamples;
+
+  // Input histograms of the occupied channels and the waveform being
+  // discriminated, reused from event to event. fSlot maps a channel to its
+  // input histogram, -1 when the channel is empty.
+  std::vector<G4int> fSlot;
+  std::vector<G4int> fOccupied;
+  std::vector<float> fInput;
+  std::vector<float> fWaveform;
+  std::vector<G4double> fNoise;
+
+  PMTDigits* fDigits;
+};
+
+#endif // PMTDIGITIZER_H_
@@ -0,0 +1,62 @@
+#ifndef PMTRESPONSE_H_
+#define PMTRESPONSE_H_
+
+#include <globals.hh>
+
+#include <vector>
+
+class G4GenericMessenger;
+
+// Settings of the PMT digitization, see PMTDigitizer.
+//
+// The single photoelectron pulse is the difference of two exponentials
+// with the rise and fall times, of unit peak height, sampled with the
+// digitizer period. Every photoelectron gets a Gaussian gain around 1,
+// dark counts are added at a fixed rate and every sample gets Gaussian
+// electronic noise. Amplitudes are in units of the single photoelectron
+// peak.
+//
+// Set on the master with /muon_lab/digi/ and read by the workers.
+class PMTResponse {
+public:
+  PMTResponse();
+  ~PMTResponse();
+
+  inline G4bool IsEnabled() const { return fEnabled; }
+  inline G4bool IsWaveformEnabled() const { return fWaveforms; }
+  // Hits are only written with the digits on request
+  inline G4bool IsKeepingHits() const { return fKeepHits; }
+  inline G4double GetSamplingPeriod() const { return fSamplingPeriod; }
+  inline G4double GetWindow() const { return fWindow; }
+  inline G4double GetPreTrigger() const { return fPreTrigger; }
+  inline G4double GetGainSpread() const { return fGainSpread; }
+  inline G4double GetNoise() const { return fNoise; }
+  inline G4double GetDarkRate() const { return fDarkRate; }
+  inline G4double GetThreshold() const { return fThreshold; }
+
+  // Samples of the window, at least one
+  G4int GetNumberOfSamples() const;
+
+  // Single photoelectron pulse at the sampling times, until it has decayed
+  std::vector<float> BuildKernel() const;
+
+private:
+  void DefineCommands();
+
+  G4GenericMessenger* fMessenger;
+
+  G4bool fEnabled;
+  G4bool fWaveforms; // also write the samples of the channels that fired
+  G4bool fKeepHits;  // also write the hits when digitizing
+  G4double fSamplingPeriod;
+  G4double fWindow;
+  G4double fPreTrigger; // window start before the first photoelectron
+  G4double fRiseTime;
+  G4double fFallTime;
+  G4double fGainSpread; // relative sigma of the single photoelectron gain
+  G4double fNoise;      // sigma of the noise of a sample
+  G4double fDarkRate;   // per channel
+  G4double fThreshold;  // leading edge discriminator
+};
+
+#endif // PMTRESPONSE_H_
@@ -0,0 +1,52 @@
+#ifndef PHYSICSLIST_H_
+#define PHYSICSLIST_H_
+
+#include <G4VModularPhysicsList.hh>
+#include <globals.hh>
+
+#include <vector>
+
+class G4GenericMessenger;
+class G4VPhysicsConstructor;
+
+// Physics list made of a named profile, chosen before /run/initialize with
+// /muon_lab/physics/profile or the -p flag:
+//   full-optical : QGSP_BERT with EM option4 and optical physics (default)
+//   calorimetric : QGSP_BERT with EM option1, no optical physics
+//   fast-muon    : standard EM, muon nuclear, decay and capture at rest
+//
+// As in the extended examples, the constructors are kept by the list and
+// called from ConstructProcess, so the profile can change in PreInit
+// after the particles are constructed. G4DecayPhysics is part of every
+// profile and constructs all the particles, G4StepLimiterPhysics applies
+// the region user limits and G4GenericBiasingPhysics wraps the muon decay
+// for DecayBiasing.
+class PhysicsList : public G4VModularPhysicsList {
+public:
+  PhysicsList();
+  virtual ~PhysicsList();
+
+  virtual void ConstructParticle();
+  virtual void ConstructProcess();
+
+  void SetProfile(const G4String& profile);
+  inline const G4String& GetProfile() const { return fProfile; }
+
+  // Constructors of the current profile, in construction order
+  inline const std::vector<G4VPhysicsConstructor*>& GetConstructors() const
+  {
+    return fConstructors;
+  }
+
+private:
+  void DefineCommands();
+  void ClearConstructors();
+
+  G4GenericMessenger* fMessenger;
+
+  G4String fProfile;
+  G4VPhysicsConstructor* fParticleList;
+  std::vector<G4VPhysicsConstructor*> fConstructors;
+};
+
+#endif // PHYSICSLIST_H_
@@ -0,0 +1,50 @@
+#ifndef PHYSICSTABLECACHE_H_
+#define PHYSICSTABLECACHE_H_
+
+#include <G4VStateDependent.hh>
+#include <globals.hh>
+
+#include <cstdint>
+
+class G4GenericMessenger;
+class PhysicsList;
+
+// On-disk cache of the physics tables of the master thread.
+//
+// At the start of the first run the physics list composition, the
+// materials and the production cuts of every region are written into a
+// description, and the tables live in <directory>/<hash of it>. When that
+// directory holds a complete cache with the same description the tables
+// are retrieved instead of built; otherwise they are built as usual and
+// stored there once the run is initialized. A table that Geant4 cannot
+// retrieve, e.g. after a change the key does not see, is simply built.
+class PhysicsTableCache : public G4VStateDependent {
+public:
+  explicit PhysicsTableCache(PhysicsList* physicsList);
+  virtual ~PhysicsTableCache();
+
+  virtual G4bool Notify(G4ApplicationState requestedState);
+
+private:
+  void DefineCommands();
+
+  // Configuration the tables depend on, one item per line
+  G4String Describe() const;
+  static std::uint64_t Hash(const G4String& text);
+
+  void PrepareRetrieval();
+  void Store();
+
+  PhysicsList* fPhysicsList;
+  G4GenericMessenger* fMessenger;
+
+  G4bool fEnabled;
+  G4String fBaseDirectory;
+
+  G4String fDescription; // of the current physics configuration
+  G4String fDirectory;   // cache directory of that description
+  G4bool fStorePending;  // the tables are built, store them at GeomClosed
+  G4bool fDone;          // the first run decided already
+};
+
+#endif // PHYSICSTABLECACHE_H_
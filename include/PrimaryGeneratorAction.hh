@@ -1,23 +1,126 @@
 #ifndef PRIMARYGENERATORACTION_H_
 #define PRIMARYGENERATORACTION_H_
 
+#include "CosmicMuonSpectrum.hh"
+#include "EventSeeder.hh"
+#include "PrimaryLibrary.hh"
+
 #include <G4VUserPrimaryGeneratorAction.hh>
 #include <globals.hh>
 
+#include <vector>
+
 class G4GeneralParticleSource;
+class G4GenericMessenger;
+class G4Material;
+class G4ParticleDefinition;
+class G4ParticleGun;
+class G4VPhysicalVolume;
 class G4Event;
 
 /// The primary generator action class with particle gun.
+///
+/// The modes available through /muon_lab/gun/mode are:
+///   gps        : the G4GeneralParticleSource configured with /gps/ commands
+///   cosmic     : sea-level cosmic muons sampled from CosmicMuonSpectrum
+///   acceptance : cosmic muons restricted to the geometric acceptance of the
+///                scintillator stack, each event carrying the analytic weight
+///                (primary vertex weight) that restores the cosmic rate
+///   library    : the primaries of /muon_lab/library/read, by event index
+///
+/// With /muon_lab/gun/stopBias the cosmic modes draw the muons that stop
+/// in the detector stack more often, the primary vertex weight corrects
+/// for it. The primaries of the other modes are stored in the library of
+/// /muon_lab/library/write when there is one.
 class PrimaryGeneratorAction : public G4VUserPrimaryGeneratorAction {
 public:
-  PrimaryGeneratorAction();
+  PrimaryGeneratorAction(const EventSeeder* eventSeeder,
+                         const PrimaryLibrary* library);
   virtual ~PrimaryGeneratorAction();
 
   // method from the base class
   virtual void GeneratePrimaries(G4Event* event);
 
+  // Rebuild the sampling tables from the current settings
+  void BeginOfRun();
+
+  void SetMode(const G4String& mode);
+
 private:
+  enum class Mode { GPS, Cosmic, Acceptance, Library };
+
+  // Axis aligned bounds of a placed volume in the world frame
+  struct Bounds {
+    G4double lo[3];
+    G4double hi[3];
+  };
+
+  // Material slab crossed by the muons on their way down
+  struct Layer {
+    G4double thickness;
+    const G4Material* material;
+  };
+
+  static Bounds WorldBounds(const G4VPhysicalVolume* volume);
+  // Bounds in the frame of the volume moved to the frame of its mother
+  static Bounds MotherBounds(const Bounds& local,
+                             const G4VPhysicalVolume* volume);
+
+  void DefineCommands();
+  void FindScintillatorStack();
+  void FindLayers();
+  G4double AcceptanceCosTheta() const;
+  // Origins on the generation plane of the lines of slopes (tx, ty) that
+  // cross every scintillator plane, empty when xlo >= xhi or ylo >= yhi
+  void StackShadow(G4double tx, G4double ty, G4double& xlo, G4double& xhi,
+                   G4double& ylo, G4double& yhi) const;
+  G4bool FindAcceptedSlopes();
+  // Azimuth whose slopes are accepted, returns the accepted fraction
+  G4double SampleAcceptedPhi(G4double slope, G4double& phi) const;
+  G4double StoppingEnergy(G4double cosTheta) const;
+  CosmicMuonSpectrum::Importance StopImportance() const;
+  void GenerateCosmicMuon(G4Event* event);
+  void ReplayPrimary(G4Event* event, G4long eventIndex);
+
+  const EventSeeder* fEventSeeder;
+  const PrimaryLibrary* fLibrary;
+
   G4GeneralParticleSource* fParticleGun;
+  G4ParticleGun* fCosmicGun;
+  G4GenericMessenger* fMessenger;
+
+  Mode fMode;
+
+  // Cosmic spectrum settings, the table is rebuilt at each run start
+  CosmicMuonSpectrum fSpectrum;
+  G4double fCosmicEmin;
+  G4double fCosmicEmax;
+  G4double fCosmicCosThetaMin;
+  G4double fChargeRatio;
+  G4int fEnergyBins;
+  G4int fAngleBins;
+  G4double fStopBias; // importance of the muons that stop, 1 is unbiased
+
+  // World half lengths, cached at the start of the run
+  G4double fWorldHalfX;
+  G4double fWorldHalfY;
+  G4double fWorldHalfZ;
+
+  // Scintillator planes and the fraction of the cosmic flux inside the
+  // zenith-angle cone they accept, used by the acceptance mode
+  std::vector<Bounds> fStack;
+  G4double fAcceptanceFlux;
+  // Slopes dx/dz and dy/dz of the lines that can cross the whole stack
+  G4double fSlopeLo[2];
+  G4double fSlopeHi[2];
+
+  // Every volume of the world, the planes of the arrays in place of their
+  // boxes, from the bottom up, for the stopping bias
+  std::vector<Layer> fLayers;
+
+  G4ParticleDefinition* fMuonPlus;
+  G4ParticleDefinition* fMuonMinus;
+  G4ParticleDefinition* fReplayed; // particle of the last replayed record
 };
 
 #endif // PRIMARYGENERATORACTION_H_
@@ -0,0 +1,55 @@
+#ifndef PRIMARYLIBRARY_H_
+#define PRIMARYLIBRARY_H_
+
+#include "PrimaryLibraryFormat.hh"
+
+#include <globals.hh>
+
+#include <cstddef>
+
+class G4Event;
+class G4GenericMessenger;
+
+// Library of generated primaries, one fixed-size record per event index,
+// see PrimaryLibraryFormat.hh.
+//
+// /muon_lab/library/write creates a library on the master. Every event
+// generated afterwards is stored at its index with one pwrite, from any
+// worker thread or forked process, in any order. /muon_lab/library/read
+// maps a library read-only and the library gun mode serves its records by
+// event index, so jobs with other geometries or settings replay the same
+// primaries without the cost of generating them.
+class PrimaryLibrary {
+public:
+  PrimaryLibrary();
+  ~PrimaryLibrary();
+
+  inline G4bool IsWriting() const { return fFd >= 0; }
+  inline G4bool IsReadable() const { return fData != nullptr; }
+
+  // Store the first primary of the event, thread safe
+  void Write(G4long eventIndex, const G4Event& event) const;
+
+  // Record of an event index, nullptr if the library does not have it
+  const primaries::Record* Find(G4long eventIndex) const;
+
+  // Create or truncate the library, "none" stops writing
+  void OpenWrite(const G4String& path);
+  void OpenRead(const G4String& path);
+
+private:
+  void CloseWrite();
+  void CloseRead();
+  void DefineCommands();
+
+  G4GenericMessenger* fMessenger;
+
+  int fFd; // library being written
+  G4String fWritePath;
+
+  const u8* fData; // mapped library being read
+  std::size_t fSize;
+  u64 fNRecords;
+};
+
+#endif // PRIMARYLIBRARY_H_
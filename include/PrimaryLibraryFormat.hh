@@ -0,0 +1,52 @@
+#ifndef PRIMARYLIBRARYFORMAT_H_
+#define PRIMARYLIBRARYFORMAT_H_
+
+// On-disk layout of the primary event libraries, see PrimaryLibrary. Only
+// depends on pft.hpp, not on Geant4.
+//
+//   FileHeader
+//   Record[n]     the record of event index i at sizeof(FileHeader) +
+//                 i * sizeof(Record)
+//
+// Events that were never written read back as zeros, without kWritten.
+// Everything is little endian and 8-byte aligned, so a mapped file can be
+// read in place.
+
+#include "pft.hpp"
+
+namespace primaries {
+
+constexpr char kFileMagic[8] = {'M', 'L', 'P', 'R', 'I', 'M', '0', '1'};
+constexpr u32 kVersion       = 1;
+constexpr u32 kWritten       = 1;
+
+struct FileHeader {
+  char magic[8];
+  u32 version;
+  u32 recordSize;
+  u64 reserved;
+};
+
+// First primary particle of an event
+struct Record {
+  i64 event; // event index (EventSeeder)
+  i32 pdg;
+  u32 flags;
+  f64 position[3]; // mm
+  f64 direction[3];
+  f64 ekin;   // MeV
+  f64 time;   // ns
+  f64 weight; // primary vertex weight
+};
+
+static_assert(sizeof(FileHeader) % 8 == 0 && sizeof(Record) % 8 == 0,
+              "primary records must keep 8-byte alignment");
+
+inline constexpr u64 RecordOffset(u64 event)
+{
+  return sizeof(FileHeader) + event * sizeof(Record);
+}
+
+} // namespace primaries
+
+#endif // PRIMARYLIBRARYFORMAT_H_
@@ -0,0 +1,95 @@
+#ifndef PROGRESSLOGGER_H_
+#define PROGRESSLOGGER_H_
+
+#include <globals.hh>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class G4GenericMessenger;
+
+// Progress and per-event logging channel of the run.
+//
+// The threads simulating events never print. Each one owns a channel with
+// an atomic event counter and a single-producer single-consumer ring of
+// compact event records, both written without locks. One reporter thread,
+// started and stopped by the master run action, wakes up every
+// /muon_lab/log/interval seconds and prints the progress of the run
+// (events/s, ETA and the rate of every worker). With /muon_lab/log/verbose
+// 1 the event records are pushed too and the reporter prints them, at
+// most /muon_lab/log/maxRecords per report; records that do not fit in a
+// full ring are dropped and counted.
+class ProgressLogger {
+public:
+  static constexpr std::size_t kMaxChannels = 8;
+
+  // Summary of one event for the verbose dump
+  struct EventRecord {
+    G4int eventID;
+    G4int nHits;
+    G4int nChannels;
+    G4double edep[kMaxChannels];
+  };
+
+  ProgressLogger();
+  ~ProgressLogger();
+
+  // Called by the master run action
+  void StartRun(G4int runID, G4int nEvents);
+  void StopRun();
+
+  // Called by the event action of the simulating thread
+  inline G4bool IsVerbose() const { return fVerbose > 0; }
+  void EventDone();
+  void PushRecord(const EventRecord& record);
+
+private:
+  static constexpr std::size_t kRingSize = 256;
+
+  struct Channel {
+    G4int threadID;
+    std::atomic<G4long> events{0};
+    std::atomic<G4long> dropped{0};
+
+    // SPSC ring, head written by the consumer and tail by the producer
+    std::array<EventRecord, kRingSize> ring;
+    std::atomic<std::size_t> head{0};
+    std::atomic<std::size_t> tail{0};
+
+    G4long reportedEvents = 0; // reporter only
+  };
+
+  void DefineCommands();
+  Channel* GetChannel();
+  void Run();
+  void Report(G4bool final);
+
+  G4GenericMessenger* fMessenger;
+
+  G4double fInterval; // seconds between reports
+  G4int fVerbose;
+  G4int fMaxRecords;
+
+  // Registration of the channels, never locked for an event
+  std::mutex fChannelsMutex;
+  std::vector<std::unique_ptr<Channel>> fChannels;
+
+  // Reporter thread
+  std::thread fReporter;
+  std::mutex fStopMutex;
+  std::condition_variable fStopCondition;
+  G4bool fStop;
+
+  G4int fRunID;
+  G4long fTotalEvents;
+  std::chrono::steady_clock::time_point fStart;
+  std::chrono::steady_clock::time_point fLastReport;
+};
+
+#endif // PROGRESSLOGGER_H_
@@ -0,0 +1,53 @@
+#ifndef REGIONSETTINGS_H_
+#define REGIONSETTINGS_H_
+
+#include <globals.hh>
+
+#include <vector>
+
+class G4GenericMessenger;
+class G4LogicalVolume;
+class G4Region;
+class G4UserLimits;
+
+// Production cuts and user limits of the three kinds of material.
+//
+// The absorber and the scintillators get regions of their own, the world
+// air stays in the default region. The production cuts are set at
+// construction (coarse in the iron, fine in the plastic) and tuned with
+// the Geant4 commands /run/setCut (world air) and /run/setCutForRegion.
+// The user limits of every region, applied by G4StepLimiterPhysics, are
+// set with /muon_lab/limits/.
+class RegionSettings {
+public:
+  enum RegionIndex { kWorld, kAbsorber, kScintillator, kNRegions };
+
+  RegionSettings();
+  ~RegionSettings();
+
+  static const char* GetName(RegionIndex index);
+
+  // Create the detector regions and attach the user limits
+  void Build(const std::vector<G4LogicalVolume*>& absorberLVs,
+             const std::vector<G4LogicalVolume*>& scintillatorLVs);
+
+  // "<region> <value> <unit>"
+  void SetMaxStep(const G4String& setting);
+  void SetMinKineticEnergy(const G4String& setting);
+
+private:
+  void DefineCommands();
+
+  // Region index and value of a setting, false if it is not valid
+  G4bool Parse(const G4String& setting, const char* unitCategory,
+               RegionIndex& index, G4double& value) const;
+
+  G4GenericMessenger* fMessenger;
+
+  G4double fCut[kNRegions]; // initial cuts of the detector regions
+  G4double fMaxStep[kNRegions];
+  G4double fMinKineticEnergy[kNRegions];
+  G4UserLimits* fLimits[kNRegions]; // null until Build
+};
+
+#endif // REGIONSETTINGS_H_
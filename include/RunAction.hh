@@ -1,10 +1,19 @@
 #ifndef RUNACTION_H_
 #define RUNACTION_H_
 
+#include "Checkpoint.hh"
+#include "ColumnarOutput.hh"
+#include "ColumnarWriter.hh"
 #include "DetectorConstruction.hh"
 #include "EventAction.hh"
 #include "PrimaryGeneratorAction.hh"
+#include "ProgressLogger.hh"
+#include "RegionSettings.hh"
+#include "StackingPolicy.hh"
+#include "VoxelScoring.hh"
 
+#include <G4Accumulable.hh>
+#include <G4Timer.hh>
 #include <G4UserRunAction.hh>
 #include <globals.hh>
 
@@ -13,17 +22,102 @@ class G4Run;
 // Run action class
 class RunAction : public G4UserRunAction {
 public:
+  // Counters of a run merged over the threads, which the end of run
+  // summaries print. Plain data, forked workers send it to their parent.
+  struct Counters {
+    G4long killedTracks[StackingPolicy::kNTrackClasses];
+    G4double killedEnergy[StackingPolicy::kNTrackClasses];
+    G4long survivedTracks[StackingPolicy::kNTrackClasses];
+    G4long secondaries[RegionSettings::kNRegions];
+    G4long accepted;
+    G4long rejected;
+    G4long aborted;
+    G4int outputBlocks;
+    G4int outputStalls;
+    G4double outputStallTime;
+    G4int outputQueueDepth;
+
+    Counters& operator+=(const Counters& other);
+  };
+
   RunAction(EventAction* eventAction, DetectorConstruction* detConstruction,
-            PrimaryGeneratorAction* primaryGenAction);
+            PrimaryGeneratorAction* primaryGenAction,
+            ProgressLogger* progressLogger,
+            const ColumnarOutput* columnarOutput, Checkpoint* checkpoint,
+            VoxelScoring* voxelScoring);
   virtual ~RunAction();
 
   virtual void BeginOfRunAction(const G4Run*);
   virtual void EndOfRunAction(const G4Run*);
 
+  // Tracks handled by the stacking action
+  inline void CountKilledTrack(StackingPolicy::TrackClass trackClass,
+                               G4double ekin)
+  {
+    fKilledTracks[trackClass] += 1;
+    fKilledEnergy[trackClass] += ekin;
+  }
+  inline void CountSurvivedTrack(StackingPolicy::TrackClass trackClass)
+  {
+    fSurvivedTracks[trackClass] += 1;
+  }
+  inline void CountSecondary(RegionSettings::RegionIndex region)
+  {
+    fSecondaries[region] += 1;
+  }
+  // Events by the event action, aborted ones are also rejected
+  inline void CountTrigger(G4bool accepted, G4bool aborted)
+  {
+    (accepted ? fAccepted : fRejected) += 1;
+    if (aborted) {
+      fAborted += 1;
+    }
+  }
+
+  inline VoxelScorer* GetVoxelScorer() { return &fVoxelScorer; }
+
+  // Of the last run, on the master after its end
+  inline const Counters& GetCounters() const { return fCounters; }
+
+  // Stacking, output and trigger summaries
+  static void PrintSummaries(const Counters& counters);
+
 private:
+  Counters CollectCounters() const;
+  static void PrintStackingSummary(const Counters& counters);
+  static void PrintOutputSummary(const Counters& counters);
+  static void PrintTriggerSummary(const Counters& counters);
+  G4String GetPhysicsProfile() const;
+
   EventAction* fEventAction;
   DetectorConstruction* fDetConstruction;
   PrimaryGeneratorAction* fPrimaryGeneratorAction;
+  ProgressLogger* fProgressLogger;
+  const ColumnarOutput* fColumnarOutput;
+  Checkpoint* fCheckpoint;
+  ColumnarWriter fColumnarWriter; // hits of this thread
+  VoxelScoring* fVoxelScoring;
+  VoxelScorer fVoxelScorer; // voxels of this thread
+
+  G4Timer fTimer; // wall time of the run on the master
+
+  G4Accumulable<G4long> fKilledTracks[StackingPolicy::kNTrackClasses];
+  G4Accumulable<G4double> fKilledEnergy[StackingPolicy::kNTrackClasses];
+  G4Accumulable<G4long> fSurvivedTracks[StackingPolicy::kNTrackClasses];
+  G4Accumulable<G4long> fSecondaries[RegionSettings::kNRegions];
+
+  // Coincidence trigger
+  G4Accumulable<G4long> fAccepted;
+  G4Accumulable<G4long> fRejected;
+  G4Accumulable<G4long> fAborted;
+
+  // Columnar output pipeline, see ColumnarWriter::Stats
+  G4Accumulable<G4int> fOutputBlocks;
+  G4Accumulable<G4int> fOutputStalls;
+  G4Accumulable<G4double> fOutputStallTime;
+  G4Accumulable<G4int> fOutputQueueDepth;
+
+  Counters fCounters;
 };
 
 #endif // RUNACTION_H_
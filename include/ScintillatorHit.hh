@@ -1,92 +1,66 @@
 #ifndef SCINTILLATORHIT_H
 #define SCINTILLATORHIT_H
 
-#include <G4Allocator.hh>
-#include <G4THitsCollection.hh>
-#include <G4ThreeVector.hh>
-#include <G4Types.hh>
-#include <G4VHit.hh>
-
-class G4AttDef;
-
-class ScintillatorHit : public G4VHit {
-public:
-  ScintillatorHit();
-
-  virtual ~ScintillatorHit();
-
-  ScintillatorHit(const ScintillatorHit& rhs);
-
-  // operators
-  const ScintillatorHit& operator=(const ScintillatorHit& rhs);
-  G4bool operator==(const ScintillatorHit& rhs) const;
-  inline void* operator new(size_t);
-  inline void operator delete(void* aHit);
-
-  virtual const std::map<G4String, G4AttDef>* GetAttDefs() const;
-  virtual std::vector<G4AttValue>* CreateAttValues() const;
-  virtual void Print();
-
-  // Setters and Getters
-  inline void SetEdep(G4double ed) { fEdep = ed; }
-  inline G4double GetEdep() { return fEdep; }
-
-  inline void SetE(G4double en) { fEnergy = en; }
-  inline G4double GetE() { return fEnergy; }
-
-  inline void SetPos(const G4ThreeVector& vec3) { fPos = vec3; }
-  inline G4ThreeVector GetPos() { return fPos; }
+#include "pft.hpp"
 
-  inline void SetTime(G4double ti) { fTime = ti; }
-  inline G4double GetTime() { return fTime; }
-
-  inline void SetParentId(G4int parentID) { fParentID = parentID; }
-  inline G4int GetParentId() { return fParentID; }
-
-  inline void SetTrId(G4int tid) { fTrID = tid; }
-  inline G4int GetTrId() { return fTrID; }
-
-  inline void SetTrLen(G4double tl) { fTrLen = tl; }
-  inline G4double GetTrLen() { return fTrLen; }
+#include <G4Types.hh>
 
-  inline void SetLocalTime(G4double ti) { fLocalTime = ti; }
-  inline G4double GetLocalTime() { return fLocalTime; }
+#include <type_traits>
+
+// Compact record of a single scintillator hit, written by
+// ScintillatorSD::ProcessHits. Energies are in MeV, times in ns and
+// lengths in mm, i.e. the units of the output columns.
+struct ScintillatorHit {
+  G4int detID;        // copy number of the scintillator
+  G4int pdg;          // PDG encoding of the particle
+  G4int parentID;     // Parent ID
+  G4int trackID;      // Track ID
+  G4int nSecondaries; // secondaries produced in the step
+  G4double edep;      // energy deposition
+  G4double energy;    // Particle energy
+  G4double pos[3];    // post step position
+  G4double time;      // global time
+  G4double trackLength;
+  G4double weight; // statistical weight of the track
+};
 
-  inline void SetParticleName(G4String&& par_name) { fParName = par_name; }
-  inline G4String GetParticleName() { return fParName; }
+static_assert(std::is_trivially_copyable<ScintillatorHit>::value,
+              "ScintillatorHit must stay a plain record");
 
-  inline void SetScintName(G4String&& scint_name) { fScintName = scint_name; }
-  inline G4String GetScintName() { return fScintName; }
+// Structure-of-arrays buffer with the hits of the current event.
+// Every worker owns its ScintillatorSD and therefore its buffer, the
+// columns are handed over to the event's pft::Particles_t by swapping the
+// vectors, so their capacity is reused from one event to the next.
+class ScintillatorHitBuffer {
+public:
+  inline void Append(const ScintillatorHit& hit)
+  {
+    fColumns.det_id.push_back(hit.detID);
+    fColumns.pdg.push_back(hit.pdg);
+    fColumns.parent_id.push_back(hit.parentID);
+    fColumns.trid.push_back(hit.trackID);
+    fColumns.n_secondaries.push_back(hit.nSecondaries);
+    fColumns.times.push_back(hit.time);
+    fColumns.edep.push_back(hit.edep);
+    fColumns.energy.push_back(hit.energy);
+    fColumns.posX.push_back(hit.pos[0]);
+    fColumns.posY.push_back(hit.pos[1]);
+    fColumns.posZ.push_back(hit.pos[2]);
+    fColumns.theta.push_back(
+        std::atan2(std::hypot(hit.pos[0], hit.pos[1]), hit.pos[2]));
+    fColumns.phi.push_back(std::atan2(hit.pos[1], hit.pos[0]));
+    fColumns.trlen.push_back(hit.trackLength);
+    fColumns.weight.push_back(hit.weight);
+  }
+
+  inline void Clear() { fColumns.ClearVecs(); }
+  inline std::size_t Size() const { return fColumns.det_id.size(); }
+
+  // Give the hits to par and take its (cleared) storage in exchange
+  inline void SwapInto(pft::Particles_t& par) { par.Swap(fColumns); }
 
 private:
-  G4double fEdep;      // energy deposition
-  G4double fEnergy;    // Particle energy
-  G4ThreeVector fPos;  // Position Vec3
-  G4double fTime;      // time
-  G4int fParentID;     // Particle ID
-  G4int fTrID;         // Track ID
-  G4double fTrLen;     // Track Length
-  G4double fLocalTime; // LocalTIme
-  G4String fParName;   // Particle Name
-  G4String fScintName; // Scintillator Name
-
-  static std::map<G4String, G4AttDef> fAttDefs;
+  pft::Particles_t fColumns;
 };
 
-using ScintillatorHitsCollection = G4THitsCollection<ScintillatorHit>;
-
-extern G4ThreadLocal G4Allocator<ScintillatorHit>* ScintillatorHitAllocator;
-
-inline void* ScintillatorHit::operator new(size_t)
-{
-  if (!ScintillatorHitAllocator)
-    ScintillatorHitAllocator = new G4Allocator<ScintillatorHit>;
-  return (void*)ScintillatorHitAllocator->MallocSingle();
-}
-
-inline void ScintillatorHit::operator delete(void* aHit)
-{
-  ScintillatorHitAllocator->FreeSingle((ScintillatorHit*)aHit);
-}
-
 #endif // SCINTILLATORHIT_H_
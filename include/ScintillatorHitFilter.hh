@@ -0,0 +1,68 @@
+#ifndef SCINTILLATORHITFILTER_H_
+#define SCINTILLATORHITFILTER_H_
+
+#include <G4ParticleDefinition.hh>
+#include <G4Step.hh>
+#include <globals.hh>
+
+#include <algorithm>
+#include <vector>
+
+class G4GenericMessenger;
+
+// Selection of the steps that ScintillatorSD records as hits.
+//
+// The rules are set with the /muon_lab/hits/ commands on the master and
+// resolved there to particle definition pointers and a detector mask, so
+// Accept() is only pointer and number comparisons. The workers' detectors
+// read the same object, which is only modified between runs.
+//
+// The default records the first step of electrons with a non zero energy
+// deposit in any scintillator.
+class ScintillatorHitFilter {
+public:
+  ScintillatorHitFilter();
+  ~ScintillatorHitFilter();
+
+  inline G4bool Accept(const G4Step* step, G4int channel, G4double edep) const
+  {
+    if (edep <= fEdepThreshold) {
+      return false;
+    }
+    if (fFirstStepOnly && !step->IsFirstStepInVolume()) {
+      return false;
+    }
+    if (!fParticles.empty()) {
+      const auto* particle = step->GetTrack()->GetParticleDefinition();
+      if (std::find(fParticles.begin(), fParticles.end(), particle) ==
+          fParticles.end()) {
+        return false;
+      }
+    }
+    if (!fDetectors.empty() &&
+        (channel >= static_cast<G4int>(fDetectors.size()) ||
+         !fDetectors[channel])) {
+      return false;
+    }
+    return step->GetPreStepPoint()->GetKineticEnergy() >= fEkinThreshold;
+  }
+
+  // Particle name or PDG encoding
+  void AddParticle(const G4String& particle);
+  void ClearParticles();
+  void AddDetector(G4int channel);
+  void ClearDetectors();
+
+private:
+  void DefineCommands();
+
+  G4GenericMessenger* fMessenger;
+
+  std::vector<const G4ParticleDefinition*> fParticles; // empty: all
+  std::vector<char> fDetectors;                         // empty: all
+  G4bool fFirstStepOnly;
+  G4double fEdepThreshold;
+  G4double fEkinThreshold;
+};
+
+#endif // SCINTILLATORHITFILTER_H_
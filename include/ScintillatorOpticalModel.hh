@@ -0,0 +1,57 @@
+#ifndef SCINTILLATOROPTICALMODEL_H_
+#define SCINTILLATOROPTICALMODEL_H_
+
+#include <globals.hh>
+
+#include <vector>
+
+class G4GenericMessenger;
+class G4Material;
+class G4Step;
+
+// Parametrized scintillation response used instead of optical photon
+// tracking.
+//
+// Every energy deposit is quenched with Birks' law (G4EmSaturation and the
+// Birks constant of the material), converted to a Poisson number of
+// photoelectrons with the scintillation yield of the material times a
+// detection efficiency, and each photoelectron gets an arrival time from
+// the scintillation decay time plus a Gaussian PMT transit time.
+//
+// When the model is enabled the G4Scintillation process is switched off,
+// so no optical photon is created. /muon_lab/optical/fastModel false
+// restores the full optical simulation for validation runs.
+class ScintillatorOpticalModel {
+public:
+  ScintillatorOpticalModel();
+  ~ScintillatorOpticalModel();
+
+  // Take the scintillation yield and decay time of the material
+  void SetScintillator(const G4Material* material);
+
+  // Switch the G4Scintillation process of the calling thread
+  void ApplyProcessActivation() const;
+
+  inline G4bool IsEnabled() const { return fEnabled; }
+
+  // Sample the photoelectrons of a step, appending their arrival times in
+  // ns to times. Returns the number of photoelectrons.
+  G4int SamplePhotoelectrons(const G4Step* step,
+                             std::vector<float>& times) const;
+
+private:
+  void DefineCommands();
+
+  G4GenericMessenger* fMessenger;
+
+  G4bool fEnabled;
+  G4double fEfficiency;        // light collection times quantum efficiency
+  G4double fTransitTime;       // mean PMT transit time
+  G4double fTransitTimeSpread; // sigma of the transit time
+
+  // From the scintillator material properties
+  G4double fYield;
+  G4double fDecayTime;
+};
+
+#endif // SCINTILLATOROPTICALMODEL_H_
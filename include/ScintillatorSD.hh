@@ -2,15 +2,30 @@
 #define SCINTILLATORSD_H_
 
 #include "ScintillatorHit.hh"
+#include "ScintillatorHitFilter.hh"
+#include "ScintillatorOpticalModel.hh"
 #include <G4VSensitiveDetector.hh> // Template class for SD
 
-class G4Step;
+#include <vector>
+
 class G4HCofThisEvent;
+class G4LogicalVolume;
+class G4Step;
 class G4TouchableHistory;
+class G4VTouchable;
 
+// Sensitive detector of the scintillators. Besides the recorded hits it
+// accumulates the total energy deposit of every scintillator, indexed by
+// the copy number of the volume, in the same ProcessHits call. Which steps
+// become hits is decided by the shared ScintillatorHitFilter. With the fast
+// optical model enabled every deposit is also converted to photoelectrons.
+// The paddles of an array share one logical volume and their channel is
+// computed from the replica and plane copy numbers.
 class ScintillatorSD : public G4VSensitiveDetector {
 public:
-  ScintillatorSD(G4String name);
+  ScintillatorSD(G4String name, G4int nChannels,
+                 const ScintillatorHitFilter* filter,
+                 const ScintillatorOpticalModel* opticalModel);
   virtual ~ScintillatorSD();
 
   virtual void Initialize(G4HCofThisEvent* HCE);
@@ -20,8 +35,66 @@ public:
   virtual void DrawAll();
   virtual void PrintAll();
 
+  // Paddles of an array: channel = first + paddle + stride * plane
+  void AddArray(const G4LogicalVolume* paddleLV, G4int first, G4int stride);
+
+  inline G4int GetNumberOfChannels() const { return fEdep.size(); }
+  inline G4double GetEdep(G4int channel) const { return fEdep[channel]; }
+
+  // Unweighted energy deposit and time of the earliest deposit (DBL_MAX
+  // without any) of a channel, as seen by the trigger
+  inline G4double GetDeposit(G4int channel) const
+  {
+    return fDeposit[channel];
+  }
+  inline G4double GetFirstTime(G4int channel) const
+  {
+    return fFirstTime[channel];
+  }
+
+  // Channels with a deposit in this event, in the order of the deposits
+  inline const std::vector<G4int>& GetTouchedChannels() const
+  {
+    return fTouched;
+  }
+
+  inline ScintillatorHitBuffer& GetHitBuffer() { return fHitBuffer; }
+
+  // Photoelectrons of the fast optical model, per channel and per
+  // photoelectron (channel, arrival time in ns)
+  inline const std::vector<G4int>& GetPhotoelectrons() const
+  {
+    return fPhotoelectrons;
+  }
+  inline const std::vector<G4int>& GetPhotoelectronChannels() const
+  {
+    return fPEChannels;
+  }
+  inline const std::vector<float>& GetPhotoelectronTimes() const
+  {
+    return fPETimes;
+  }
+
 private:
-  ScintillatorHitsCollection* fScintHitCollection;
+  struct Array {
+    const G4LogicalVolume* paddleLV;
+    G4int first;
+    G4int stride;
+  };
+
+  G4int GetChannel(const G4VTouchable* touchable) const;
+
+  const ScintillatorHitFilter* fFilter;
+  const ScintillatorOpticalModel* fOpticalModel;
+  ScintillatorHitBuffer fHitBuffer;
+  std::vector<G4double> fEdep; // total energy deposit per copy number
+  std::vector<G4double> fDeposit;
+  std::vector<G4double> fFirstTime;
+  std::vector<G4int> fPhotoelectrons;
+  std::vector<G4int> fPEChannels;
+  std::vector<float> fPETimes;
+  std::vector<G4int> fTouched; // only these channels are reset per event
+  std::vector<Array> fArrays;
 };
 
 #endif // SCINTILLATORSD_H_
@@ -0,0 +1,40 @@
+#ifndef STACKINGACTION_H_
+#define STACKINGACTION_H_
+
+#include "RegionSettings.hh"
+#include "RunAction.hh"
+#include "StackingPolicy.hh"
+
+#include <G4UserStackingAction.hh>
+#include <globals.hh>
+
+class G4LogicalVolume;
+class G4Region;
+
+// Stacking action class, applies the StackingPolicy to every new secondary
+// and counts in the run action the secondaries produced in each region and
+// the killed and rouletted tracks.
+class StackingAction : public G4UserStackingAction {
+public:
+  StackingAction(const StackingPolicy* policy, RunAction* runAction);
+  virtual ~StackingAction();
+
+  virtual G4ClassificationOfNewTrack ClassifyNewTrack(const G4Track* track);
+
+private:
+  void FindRegions();
+  void CountSecondary(const G4LogicalVolume* lv);
+
+  // Track class of a secondary, or kNTrackClasses if none applies
+  StackingPolicy::TrackClass Classify(const G4Track* track,
+                                      const G4LogicalVolume* lv);
+
+  const StackingPolicy* fPolicy;
+  RunAction* fRunAction;
+
+  // Looked up at the first track, the geometry is built by then
+  G4bool fRegionsFound;
+  const G4Region* fRegions[RegionSettings::kNRegions];
+};
+
+#endif // STACKINGACTION_H_
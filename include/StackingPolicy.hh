@@ -0,0 +1,58 @@
+#ifndef STACKINGPOLICY_H_
+#define STACKINGPOLICY_H_
+
+#include <globals.hh>
+
+class G4GenericMessenger;
+
+// What StackingAction does with the secondaries of each track class.
+//
+// A class can be kept, killed, or Russian-rouletted: a rouletted track
+// survives with the given probability and its weight is divided by it, so
+// the weighted energy deposits stay unbiased. Primaries are always kept.
+//
+// The policy is set with the /muon_lab/stack/ commands on the master and
+// read by the workers' stacking actions, like ScintillatorHitFilter.
+class StackingPolicy {
+public:
+  enum TrackClass {
+    kOpticalOutsideScintillator, // optical photons born outside an SD volume
+    kAbsorberElectron,           // electrons below threshold in the absorber
+    kInAir,                      // anything born in air
+    kNTrackClasses
+  };
+
+  enum Action { kKeep, kKill, kRoulette };
+
+  StackingPolicy();
+  ~StackingPolicy();
+
+  inline Action GetAction(TrackClass trackClass) const
+  {
+    return fAction[trackClass];
+  }
+  inline G4double GetSurvivalProbability(TrackClass trackClass) const
+  {
+    return fSurvivalProbability[trackClass];
+  }
+  inline G4double GetElectronThreshold() const { return fElectronThreshold; }
+
+  static const char* GetClassName(TrackClass trackClass);
+
+  // "keep", "kill" or "roulette <survival probability>"
+  void SetOpticalPolicy(const G4String& policy);
+  void SetAbsorberElectronPolicy(const G4String& policy);
+  void SetAirPolicy(const G4String& policy);
+
+private:
+  void DefineCommands();
+  void SetPolicy(TrackClass trackClass, const G4String& policy);
+
+  G4GenericMessenger* fMessenger;
+
+  Action fAction[kNTrackClasses];
+  G4double fSurvivalProbability[kNTrackClasses];
+  G4double fElectronThreshold;
+};
+
+#endif // STACKINGPOLICY_H_
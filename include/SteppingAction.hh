@@ -0,0 +1,24 @@
+#ifndef STEPPINGACTION_H_
+#define STEPPINGACTION_H_
+
+#include "VoxelScoring.hh"
+
+#include <G4UserSteppingAction.hh>
+#include <globals.hh>
+
+class G4Step;
+
+// Stepping action class, fills the voxel scorer of the thread when the
+// voxel scoring is enabled. Optical photons are not scored.
+class SteppingAction : public G4UserSteppingAction {
+public:
+  explicit SteppingAction(VoxelScorer* scorer);
+  virtual ~SteppingAction();
+
+  virtual void UserSteppingAction(const G4Step* step);
+
+private:
+  VoxelScorer* fScorer;
+};
+
+#endif // STEPPINGACTION_H_
@@ -0,0 +1,44 @@
+#ifndef TRACKINGACTION_H_
+#define TRACKINGACTION_H_
+
+#include "CoincidenceTrigger.hh"
+
+#include <G4UserTrackingAction.hh>
+#include <globals.hh>
+
+class G4Event;
+class G4ParticleDefinition;
+class ScintillatorSD;
+
+// Tracking action class, keeps the energy budget of the event for the
+// early abort of the coincidence trigger.
+//
+// The budget is the energy the particles not tracked yet can still
+// release: the primaries at the start of the event, minus every track
+// when it starts, plus its secondaries when it ends. Deposits so far plus
+// the budget bound the final deposits, so the event is aborted when the
+// bound of a required channel falls below its threshold.
+class TrackingAction : public G4UserTrackingAction {
+public:
+  explicit TrackingAction(const CoincidenceTrigger* trigger);
+  virtual ~TrackingAction();
+
+  // From EventAction::BeginOfEventAction, the budget of the primaries
+  void BeginEvent(const G4Event* event);
+
+  virtual void PreUserTrackingAction(const G4Track* track);
+  virtual void PostUserTrackingAction(const G4Track* track);
+
+  // Kinetic energy, plus the mass of particles that decay or annihilate
+  // and the capture energy of neutrons
+  static G4double ReleasableEnergy(const G4ParticleDefinition* particle,
+                                   G4double ekin);
+
+private:
+  const CoincidenceTrigger* fTrigger;
+  ScintillatorSD* fScintillatorSD;
+
+  G4double fBudget;
+};
+
+#endif // TRACKINGACTION_H_
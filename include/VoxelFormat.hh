@@ -0,0 +1,63 @@
+#ifndef VOXELFORMAT_H_
+#define VOXELFORMAT_H_
+
+// On-disk layout of the voxel scoring dumps, see VoxelScoring. Only
+// depends on pft.hpp, not on Geant4.
+//
+// A file holds the merged grid of one run:
+//
+//   FileHeader
+//   dense:  f64 edep[nBins]     energy deposit in MeV, weighted
+//           f64 length[nBins]   track length in mm, weighted
+//   sparse: u64 bin[nFilled]    increasing bin indices
+//           f64 edep[nFilled]
+//           f64 length[nFilled]
+//
+// with bin = ix + nx * (iy + ny * iz). The sparse layout is written when
+// it is the smaller one. Everything is little endian and 8-byte aligned.
+//
+// A run resumed from a checkpoint writes <fileName>_resume<k>_run<R>.vox
+// with the partial sums of its own events, nEvents counts only these: the
+// grid of the crashed attempt is never dumped.
+
+#include "pft.hpp"
+
+#include <cstddef>
+
+namespace voxel {
+
+constexpr char kFileMagic[8] = {'M', 'L', 'V', 'O', 'X', 'E', 'L', '1'};
+constexpr u32 kVersion       = 1;
+
+struct FileHeader {
+  char magic[8];
+  u32 version;
+  u32 sparse; // 1 for the sparse layout
+  i32 run;
+  i32 reserved;
+  u64 nEvents;
+  u64 nFilled; // bins with a deposit or a track length
+  u32 bins[3];
+  u32 padding;
+  f64 lower[3]; // corners of the grid in the world frame, mm
+  f64 upper[3];
+};
+
+static_assert(sizeof(FileHeader) % 8 == 0,
+              "voxel records must keep 8-byte alignment");
+
+inline constexpr u64 NumberOfBins(const u32 bins[3])
+{
+  return u64(bins[0]) * bins[1] * bins[2];
+}
+
+// Bytes after the header of either layout
+inline constexpr u64 DenseSize(u64 nBins) { return 2 * nBins * sizeof(f64); }
+inline constexpr u64 SparseSize(u64 nFilled)
+{
+  return nFilled * (sizeof(u64) + 2 * sizeof(f64));
+}
+
+} // namespace voxel
+
+#endif // VOXELFORMAT_H_
@@ -0,0 +1,99 @@
+#ifndef VOXELSCORING_H_
+#define VOXELSCORING_H_
+
+#include <G4ThreeVector.hh>
+#include <globals.hh>
+
+#include <atomic>
+#include <cstddef>
+
+class G4GenericMessenger;
+
+// Box of nx * ny * nz voxels, aligned with the world axes
+struct VoxelGrid {
+  G4int bins[3]        = {0, 0, 0};
+  G4double lower[3]    = {0., 0., 0.};
+  G4double upper[3]    = {0., 0., 0.};
+  G4double invWidth[3] = {0., 0., 0.};
+
+  inline std::size_t GetNumberOfBins() const
+  {
+    return std::size_t(bins[0]) * bins[1] * bins[2];
+  }
+};
+
+// Thread-local energy deposit and track length of a voxel grid, filled
+// from the stepping action of the thread. The arrays are calloc'ed, so
+// the pages of voxels no track reaches are never touched and a sparse
+// 10^7 voxel grid costs little more than its filled part.
+class VoxelScorer {
+public:
+  VoxelScorer();
+  ~VoxelScorer();
+  VoxelScorer(const VoxelScorer&) = delete;
+  VoxelScorer& operator=(const VoxelScorer&) = delete;
+
+  // Zeroed arrays for the grid, freed when grid has no voxels
+  void Reset(const VoxelGrid& grid);
+
+  inline G4bool IsActive() const { return fEdep != nullptr; }
+
+  // The deposit goes to the voxel of the middle of the step, the length
+  // of the step is shared among the voxels it crosses
+  void Score(const G4ThreeVector& start, const G4ThreeVector& end,
+             G4double edep, G4double weight);
+
+  inline G4double* GetEdep() const { return fEdep; }
+  inline G4double* GetLength() const { return fLength; }
+
+private:
+  friend class VoxelScoring;
+
+  VoxelGrid fGrid;
+  G4double* fEdep;
+  G4double* fLength;
+  VoxelScorer* fNext; // in the list of the published scorers
+};
+
+// Settings of the voxel scoring and merge of the thread-local scorers.
+//
+// Set on the master with the /muon_lab/scoring/ commands. The master
+// builds the grid at the start of a run, over the bounding box of the
+// chosen volume. At the end of the run every thread that simulated
+// events publishes its scorer with one atomic push, and the master sums
+// them into the first one, in cache-sized chunks the compiler vectorizes,
+// then writes <fileName>_run<R>.vox, see VoxelFormat.hh.
+class VoxelScoring {
+public:
+  VoxelScoring();
+  ~VoxelScoring();
+
+  inline G4bool IsEnabled() const { return fEnabled; }
+  inline const VoxelGrid& GetGrid() const { return fGrid; }
+
+  // Master only, the geometry is built by then
+  void BeginOfRun();
+  void EndOfRun(G4int run, G4int nEvents);
+
+  // Called by every thread at the end of its run, lock-free
+  void Publish(VoxelScorer* scorer);
+
+  // Number of bins along x, y and z
+  void SetBins(const G4String& bins);
+
+private:
+  void DefineCommands();
+  void Write(const VoxelScorer& total, G4int run, G4int nEvents) const;
+
+  G4GenericMessenger* fMessenger;
+
+  G4bool fEnabled;
+  G4String fVolume;
+  G4String fFileName;
+  G4int fBins[3];
+
+  VoxelGrid fGrid;
+  std::atomic<VoxelScorer*> fPublished;
+};
+
+#endif // VOXELSCORING_H_
@@ -21,6 +21,10 @@
 // ============================================================
 //
 // ChangeLog:
+//   0.0.11   AParse: positional arguments
+//   0.0.10   AParse: index based Parse, flags without value, has
+//   0.0.9    Particles_t: weight
+//   0.0.8    Particles_t: pdg, Swap
 //   0.0.7    linspace, pad_left, pad_right
 //            zip_with, zip_to_pair
 //            remove zip,
@@ -239,12 +243,13 @@ struct StringView : public std::string_view {
 // Particles struct usefull for Geant4
 //////////////////////////////////////////////////
 struct Particles_t {
-  std::vector<i32> det_id, parent_id, trid, n_secondaries;
+  std::vector<i32> det_id, pdg, parent_id, trid, n_secondaries;
   std::vector<f64> times, edep, energy, posX, posY, posZ;
-  std::vector<f64> theta, phi, trlen;
+  std::vector<f64> theta, phi, trlen, weight;
 
   void Reserve(const std::size_t nparticles) {
     det_id.reserve(nparticles);
+    pdg.reserve(nparticles);
     parent_id.reserve(nparticles);
     trid.reserve(nparticles);
     times.reserve(nparticles);
@@ -256,11 +261,13 @@ struct Particles_t {
     theta.reserve(nparticles);
     phi.reserve(nparticles);
     trlen.reserve(nparticles);
+    weight.reserve(nparticles);
     n_secondaries.reserve(nparticles);
   }
 
   void ClearVecs() {
     det_id.clear();
+    pdg.clear();
     parent_id.clear();
     trid.clear();
     times.clear();
@@ -272,8 +279,28 @@ struct Particles_t {
     theta.clear();
     phi.clear();
     trlen.clear();
+    weight.clear();
     n_secondaries.clear();
   }
+
+  // swap the contents, the vector objects themselves keep their addresses
+  void Swap(Particles_t& other) {
+    det_id.swap(other.det_id);
+    pdg.swap(other.pdg);
+    parent_id.swap(other.parent_id);
+    trid.swap(other.trid);
+    times.swap(other.times);
+    edep.swap(other.edep);
+    energy.swap(other.energy);
+    posX.swap(other.posX);
+    posY.swap(other.posY);
+    posZ.swap(other.posZ);
+    theta.swap(other.theta);
+    phi.swap(other.phi);
+    trlen.swap(other.trlen);
+    weight.swap(other.weight);
+    n_secondaries.swap(other.n_secondaries);
+  }
 };
 
 // StringView utilities
@@ -1026,6 +1053,7 @@ struct AParse {
   std::deque<char*> args;
   std::vector<ArgOption> flags;
   std::map<std::string, std::pair<ArgOption, std::string>> arg_table;
+  std::vector<std::string> positional; // arguments not starting with '-'
 
   AParse(int argc, char** a) : nArgs(argc) {
 
@@ -1040,33 +1068,34 @@ struct AParse {
     }
   }
 
-  void Parse() {
-    if (nArgs == 1) {
-      PrintUsage();
-      return;
-    }
+  // Returns false on an unknown argument or a missing value
+  bool Parse() {
+    for (std::size_t i = 1; i < args.size(); ++i) {
+      const std::string arg = args[i];
+      if (!arg.empty() && arg[0] != '-') {
+        positional.push_back(arg);
+        continue;
+      }
+      auto flag = std::find_if(flags.begin(), flags.end(), [&arg](auto& f) {
+        return arg == f.short_op || arg == f.long_op;
+      });
 
-    for (auto [i, arg] : ::pft::enumerate(args)) {
-      for (std::size_t j = 0; j < flags.size(); ++j) {
-        if (arg == flags[j].short_op || arg == flags[j].long_op) {
-          if (flags[j].accepts_value) {
-            if (i + 1 >= nArgs) {
-              fprintf(stderr, "Missing argument for flag `%s` \n", arg);
-              return;
-            } else {
-              arg_table.insert({flags[j].short_op, {flags[j], args[i + 1]}});
-              args.pop_front();
-            }
-          } else {
-            arg_table.insert({flags[j].short_op, {flags[j], ""}});
-            args.pop_front();
-            fprintf(stderr, "TODO: handle non-accepting value args\n");
-          }
+      if (flag == flags.end()) {
+        fprintf(stderr, "Unknown argument `%s` \n", arg.c_str());
+        return false;
+      }
+
+      if (flag->accepts_value) {
+        if (i + 1 >= args.size()) {
+          fprintf(stderr, "Missing argument for flag `%s` \n", arg.c_str());
+          return false;
         }
+        arg_table[flag->short_op] = {*flag, args[++i]};
+      } else {
+        arg_table[flag->short_op] = {*flag, ""};
       }
     }
-
-    // fprintf(stdout, "[DBG]: %zu\n", options.size());
+    return true;
   }
 
   void Add(ArgOption opt) { flags.push_back(opt); }
@@ -1077,12 +1106,15 @@ struct AParse {
     }
   }
 
+  // true if the flag was given, with or without a value
+  bool has(const std::string& flag) const {
+    return arg_table.find(flag) != arg_table.end();
+  }
+
   Maybe<std::string> value_of(std::string flag) {
-    // TODO: check if flag exist
     auto val = arg_table.find(flag);
 
     if (val != arg_table.end()) {
-      println(stdout, "[DBG]: ", val->second.second.c_str());
       return {val->second.first.accepts_value, val->second.second};
     } else {
       return {false, ""};
@@ -1,70 +1,131 @@
 #include "ActionInitialization.hh"
 #include "Analysis.hh"
 #include "DetectorConstruction.hh"
+#include "ForkedRun.hh"
+#include "PhysicsList.hh"
+#include "PhysicsTableCache.hh"
+#include "pft.hpp"
 
 #ifdef G4MULTITHREADED
 #include <G4MTRunManager.hh>
-#else
-#include <G4RunManager.hh>
 #endif
 
-#include <G4EmStandardPhysics_option4.hh>
-#include <QGSP_BERT.hh>
-
-#include <G4OpticalPhysics.hh>
-#include <G4ScoringManager.hh>
+#include <G4RunManager.hh>
+#include <G4StateManager.hh>
 #include <G4UIExecutive.hh>
 #include <G4UImanager.hh>
 #include <G4VisExecutive.hh>
 
-#include <Randomize.hh>
+#include <cstdlib>
+#include <string>
 
 namespace {
-void PrintUsage()
+void PrintUsage(pft::AParse& parser)
 {
   G4cerr << " How to use the program: " << G4endl;
-  G4cerr << " bm_electron [-m macro] [-u UIsession] " << G4endl;
+  G4cerr << " muon_lab [-m macro] [-u UIsession] [-b] [-t threads] "
+            "[-n events] [-s seed] [-o output] [-p profile] [-f processes] "
+            "[-r checkpoint] [-g geometry]"
+         << G4endl;
+  parser.PrintUsage();
+}
+
+// Integer value of a command line flag, false if it is not a number
+G4bool ToInteger(const std::string& value, G4long& result)
+{
+  char* end = nullptr;
+  result    = std::strtol(value.c_str(), &end, 10);
+  return !value.empty() && *end == '\0';
 }
 } // namespace
 
 int main(int argc, char* argv[])
 {
-  if (argc > 7) {
-    PrintUsage();
+  pft::AParse parser(argc, argv);
+  parser.Add({"-m", "--macro", "macro to execute", true});
+  parser.Add({"-u", "--ui", "UI session type", true});
+  parser.Add({"-b", "--batch", "run without visualization and UI", false});
+  parser.Add({"-t", "--threads", "number of worker threads", true});
+  parser.Add({"-n", "--events", "events to simulate after the macro", true});
+  parser.Add({"-s", "--seed", "run seed, see /muon_lab/random/seed", true});
+  parser.Add({"-o", "--output", "output file name", true});
+  parser.Add({"-p", "--physics", "physics profile", true});
+  parser.Add({"-f", "--fork", "worker processes forked after initialization",
+              true});
+  parser.Add({"-r", "--resume", "resume the run of a checkpoint", true});
+  parser.Add({"-g", "--geometry", "detector stack file", true});
+  parser.Add({"-h", "--help", "print this message", false});
+
+  if (!parser.Parse() || !parser.positional.empty() || parser.has("-h")) {
+    PrintUsage(parser);
+    return parser.has("-h") ? 0 : 1;
+  }
+
+  const G4String macro   = parser.value_of("-m").unwrap;
+  const G4String session = parser.value_of("-u").unwrap;
+  const G4bool batch     = parser.has("-b");
+
+  G4long threads = 0;
+  G4long events  = 0;
+  G4long seed      = 0;
+  G4long processes = 1;
+  if ((parser.has("-t") && !ToInteger(parser.value_of("-t").unwrap, threads)) ||
+      (parser.has("-n") && !ToInteger(parser.value_of("-n").unwrap, events)) ||
+      (parser.has("-s") && !ToInteger(parser.value_of("-s").unwrap, seed)) ||
+      (parser.has("-f") &&
+       !ToInteger(parser.value_of("-f").unwrap, processes)) ||
+      processes < 1) {
+    PrintUsage(parser);
     return 1;
   }
 
-  G4String macro;
-  G4String session;
-  for (G4int i = 1; i < argc; i = i + 2) {
-    if (G4String(argv[i]) == "-m") {
-      macro = argv[i + 1];
-    } else if (G4String(argv[i]) == "-u") {
-      session = argv[i + 1];
-    } else {
-      PrintUsage();
-      return 1;
-    }
+  if (processes > 1 && (!batch || events <= 0)) {
+    G4cerr << " Worker processes (-f) need batch mode (-b) and events (-n)"
+           << G4endl;
+    return 1;
+  }
+
+  // The checkpoint holds the files of one process, its forks would each
+  // resume the whole run
+  if (processes > 1 && parser.has("-r")) {
+    G4cerr << " A checkpoint (-r) is resumed by a single process, without -f"
+           << G4endl;
+    return 1;
+  }
+
+  if (batch && !macro.size() && !parser.has("-n") && !parser.has("-r")) {
+    G4cerr << " Batch mode needs a macro (-m), a number of events (-n) or a "
+              "checkpoint (-r)"
+           << G4endl;
+    return 1;
   }
 
   // Detect interactive mode
   G4UIExecutive* ui = nullptr;
-  if (!macro.size()) {
+  if (!batch && !macro.size()) {
     ui = new G4UIExecutive(argc, argv, session);
   }
 
+  // Every event is reseeded from /muon_lab/random/seed and its index by
+  // EventSeeder, so both builds keep the default engine and give the same
+  // events whatever the number of threads or processes
+  G4RunManager* runManager = nullptr;
 #ifdef G4MULTITHREADED
-  // in MT Mode the random engine uses the same seeds
-  auto* runManager = new G4MTRunManager;
-#else
-  // Random engine
-  G4Random::setTheEngine(new CLHEP::RanecuEngine);
-  G4Random::setTheSeed(100);
-  auto* runManager = new G4RunManager;
+  if (processes == 1) {
+    auto* mtRunManager = new G4MTRunManager;
+    if (threads > 0) {
+      mtRunManager->SetNumberOfThreads(threads);
+    }
+    runManager = mtRunManager;
+  }
 #endif
-  // Activate command-based scorer
-  G4ScoringManager::GetScoringManager();
-
+  if (!runManager) {
+    // Worker processes are forked from a sequential run manager
+    runManager = new G4RunManager;
+    if (threads > 0) {
+      G4cerr << " Sequential run manager, -t is ignored" << G4endl;
+    }
+  }
   // Mandatory Initialization classes
 
   // Detector construction
@@ -73,36 +134,73 @@ int main(int argc, char* argv[])
 
   // Physics list
 
-  G4VModularPhysicsList* physicsList = new QGSP_BERT;
-  physicsList->ReplacePhysics(new G4EmStandardPhysics_option4());
+  // The profile can still be changed by -p or a macro before initialization
+  auto* physicsList = new PhysicsList();
   physicsList->SetVerboseLevel(0);
-  auto* opticalPhysics = new G4OpticalPhysics();
-  opticalPhysics->Configure(kCerenkov, false);
-  opticalPhysics->SetCerenkovStackPhotons(true);
-  opticalPhysics->Configure(kScintillation, true);
-
-  physicsList->RegisterPhysics(opticalPhysics);
-  physicsList->DumpList();
   runManager->SetUserInitialization(physicsList);
 
+  // Physics tables are retrieved from /muon_lab/physics/cache/directory when
+  // a cache of this configuration exists
+  auto* physicsTableCache = new PhysicsTableCache(physicsList);
+
   // User action initialization
   auto* actionInit = new ActionInitialization(detConstruction);
   runManager->SetUserInitialization(actionInit);
   // runManager->Initialize();
 
-  // Initialize visualization
-  auto* visManager = new G4VisExecutive;
-  visManager->Initialize();
+  // Visualization is not needed in batch mode
+  G4VisManager* visManager = nullptr;
+  if (!batch) {
+    visManager = new G4VisExecutive;
+    visManager->Initialize();
+  }
 
   // Pointer to User Interface manager
   auto* UImanager = G4UImanager::GetUIpointer();
 
+  // Command line settings, applied before the macro so it can change them
+  if (parser.has("-s")) {
+    UImanager->ApplyCommand("/muon_lab/random/seed " + std::to_string(seed));
+  }
+  if (parser.has("-p")) {
+    UImanager->ApplyCommand("/muon_lab/physics/profile " +
+                            parser.value_of("-p").unwrap);
+  }
+  if (parser.has("-g")) {
+    UImanager->ApplyCommand("/muon_lab/geometry/file " +
+                            parser.value_of("-g").unwrap);
+  }
+  if (parser.has("-o")) {
+    UImanager->ApplyCommand("/analysis/setFileName " +
+                            parser.value_of("-o").unwrap);
+  }
+
   // Process macro or start UI session
 
-  if (macro.size()) {
+  G4int status = 0;
+  if (macro.size() || batch) {
     // batch mode
-    G4String command = "/control/execute ";
-    UImanager->ApplyCommand(command + macro);
+    if (macro.size()) {
+      G4String command = "/control/execute ";
+      UImanager->ApplyCommand(command + macro);
+    }
+    if (events > 0 || parser.has("-r")) {
+      if (G4StateManager::GetStateManager()->GetCurrentState() ==
+          G4State_PreInit) {
+        UImanager->ApplyCommand("/run/initialize");
+      }
+      if (parser.has("-r")) {
+        // Runs the events the checkpoint is missing, -n is not used
+        UImanager->ApplyCommand("/muon_lab/checkpoint/resume " +
+                                parser.value_of("-r").unwrap);
+      } else if (processes > 1) {
+        // Returns in the parent and in every worker process
+        ForkedRun forkedRun(processes);
+        status = forkedRun.BeamOn(events);
+      } else {
+        UImanager->ApplyCommand("/run/beamOn " + std::to_string(events));
+      }
+    }
   } else {
     // interactive mode
     UImanager->ApplyCommand("/control/execute init_vis.mac");
@@ -114,6 +212,8 @@ int main(int argc, char* argv[])
   }
   // Job Termination
 
+  delete physicsTableCache;
   delete visManager;
   delete runManager;
+  return status;
 }
@@ -2,33 +2,59 @@
 #include "EventAction.hh"
 #include "PrimaryGeneratorAction.hh"
 #include "RunAction.hh"
+#include "StackingAction.hh"
+#include "SteppingAction.hh"
+#include "TrackingAction.hh"
 
 ActionInitialization::ActionInitialization(
     DetectorConstruction* detectorConstruction)
-    : G4VUserActionInitialization(), fDetectorConstruction(detectorConstruction)
+    : G4VUserActionInitialization(),
+      fDetectorConstruction(detectorConstruction), fStackingPolicy(),
+      fEventSeeder(), fProgressLogger(new ProgressLogger()),
+      fColumnarOutput(), fCheckpoint(new Checkpoint(&fEventSeeder)),
+      fTrigger(), fPMTResponse(), fVoxelScoring(), fPrimaryLibrary()
 {
 }
 
-ActionInitialization::~ActionInitialization() {}
+ActionInitialization::~ActionInitialization()
+{
+  delete fCheckpoint;
+  delete fProgressLogger;
+}
 
 void ActionInitialization::BuildForMaster() const
 {
-  auto PrimaryGenAction = new PrimaryGeneratorAction();
-  auto event_action     = new EventAction();
+  auto PrimaryGenAction =
+      new PrimaryGeneratorAction(&fEventSeeder, &fPrimaryLibrary);
+  auto event_action     =
+      new EventAction(&fEventSeeder, fProgressLogger, &fTrigger,
+                      &fPMTResponse);
 
-  SetUserAction(
-      new RunAction(event_action, fDetectorConstruction, PrimaryGenAction));
+  SetUserAction(new RunAction(event_action, fDetectorConstruction,
+                              PrimaryGenAction, fProgressLogger,
+                              &fColumnarOutput, fCheckpoint, &fVoxelScoring));
 }
 
 void ActionInitialization::Build() const
 {
-  auto PrimaryGenAction = new PrimaryGeneratorAction();
+  auto PrimaryGenAction =
+      new PrimaryGeneratorAction(&fEventSeeder, &fPrimaryLibrary);
   SetUserAction(PrimaryGenAction);
 
-  auto event_action = new EventAction();
+  auto event_action =
+      new EventAction(&fEventSeeder, fProgressLogger, &fTrigger,
+                      &fPMTResponse);
   SetUserAction(event_action);
 
   auto run_action =
-      new RunAction(event_action, fDetectorConstruction, PrimaryGenAction);
+      new RunAction(event_action, fDetectorConstruction, PrimaryGenAction,
+                    fProgressLogger, &fColumnarOutput, fCheckpoint,
+                    &fVoxelScoring);
   SetUserAction(run_action);
+
+  SetUserAction(new StackingAction(&fStackingPolicy, run_action));
+  auto tracking_action = new TrackingAction(&fTrigger);
+  event_action->SetTrackingAction(tracking_action);
+  SetUserAction(tracking_action);
+  SetUserAction(new SteppingAction(run_action->GetVoxelScorer()));
 }
@@ -0,0 +1,447 @@
+#include "Checkpoint.hh"
+#include "Analysis.hh"
+#include "EventSeeder.hh"
+
+#include <G4Exception.hh>
+#include <G4GenericMessenger.hh>
+#include <G4SystemOfUnits.hh>
+#include <G4UIcommand.hh>
+#include <G4UImanager.hh>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#include <unistd.h>
+
+namespace {
+const char* const kCheckpointMagic = "muon_lab-checkpoint";
+const G4int kCheckpointVersion     = 2;
+} // namespace
+
+Checkpoint::Checkpoint(EventSeeder* eventSeeder)
+    : fEventSeeder(eventSeeder), fMessenger(nullptr), fEnabled(false),
+      fFileName("muon_lab.ckpt"), fInterval(60. * s), fWriting(false),
+      fWrites(0), fWriteTime(0.), fWriteFailed(false), fActive(false),
+      fResuming(false), fResumed(false), fUserSeed(0), fUserRunIndex(-1),
+      fSeed(0), fRunIndex(0), fEventOffset(0), fNEvents(0), fResumes(0),
+      fAccepted(0), fRejected(0), fAborted(0)
+{
+  DefineCommands();
+}
+
+Checkpoint::~Checkpoint() { delete fMessenger; }
+
+void Checkpoint::BeginRun(G4int runID, G4int nEvents)
+{
+  std::lock_guard<std::mutex> lock(fMutex);
+  fActive = fEnabled;
+  if (!fActive) {
+    return;
+  }
+
+  // A resumed run keeps the settings and the progress of the checkpoint
+  if (!fResuming) {
+    fSeed         = fEventSeeder->GetSeed();
+    fRunIndex     = fEventSeeder->GetRunIndex(runID);
+    fEventOffset  = fEventSeeder->GetEventOffset();
+    fNEvents      = nEvents;
+    fResumes      = 0;
+    fAccepted     = 0;
+    fRejected     = 0;
+    fAborted      = 0;
+    fOutputName   = G4UImanager::GetUIpointer()->GetCurrentValues(
+        "/muon_lab/output/fileName");
+    fAnalysisName = G4AnalysisManager::Instance()->GetFileName();
+    fScoringName  = G4UImanager::GetUIpointer()->GetCurrentValues(
+        "/muon_lab/scoring/fileName");
+    fDone.clear();
+    fFiles.clear();
+  }
+  fResumed     = fResuming;
+  fResuming    = false;
+  fWrites      = 0;
+  fWriteTime   = 0.;
+  fWriteFailed = false;
+  fLastWrite   = std::chrono::steady_clock::now();
+}
+
+void Checkpoint::EndRun()
+{
+  std::unique_lock<std::mutex> lock(fMutex);
+  if (!fActive) {
+    return;
+  }
+  Write(lock);
+  fActive = false;
+  fEventSeeder->SetEventList({});
+
+  // The counters of the run cover the resumed events only
+  if (fResumed && fRejected > 0) {
+    G4cout << "INFO: trigger over all attempts: " << fAccepted
+           << " accepted, " << fRejected << " rejected (" << fAborted
+           << " aborted early)" << G4endl;
+  }
+
+  // The next runs are numbered and seeded as before the resume
+  if (fResumed) {
+    fEventSeeder->SetSeed(fUserSeed);
+    fEventSeeder->SetRunIndex(fUserRunIndex);
+    fResumed = false;
+  }
+
+  G4cout << "INFO: " << fWrites << " checkpoints written to " << fFileName
+         << " in " << fWriteTime << " s" << G4endl;
+  if (fWriteFailed) {
+    G4ExceptionDescription msg;
+    msg << "Cannot write the checkpoint " << fFileName;
+    G4Exception("Checkpoint::EndRun()", "MyCode0016", JustWarning, msg);
+  }
+}
+
+G4int Checkpoint::AddFile(const G4String& path, int fd, u64 end)
+{
+  std::lock_guard<std::mutex> lock(fMutex);
+  if (!fActive) {
+    return -1;
+  }
+  fFiles.push_back({path, fd, end, {}});
+  return fFiles.size() - 1;
+}
+
+void Checkpoint::BlockWritten(G4int file,
+                              const columnar::BlockIndexEntry* entry,
+                              u64 end, const std::vector<i64>& events,
+                              const std::vector<i64>& rejected, G4long aborted)
+{
+  // A block holds a few ranges, the lock only merges them
+  std::vector<i64> done(events);
+  done.insert(done.end(), rejected.begin(), rejected.end());
+  const auto ranges = ToRanges(std::move(done));
+
+  std::unique_lock<std::mutex> lock(fMutex);
+  if (entry) {
+    fFiles[file].blocks.push_back(*entry);
+    fFiles[file].end = end;
+  }
+  AddRanges(fDone, ranges);
+  fAccepted += events.size();
+  fRejected += rejected.size();
+  fAborted += aborted;
+
+  // The writer thread that comes after the interval pays for the write,
+  // the others go on while it runs
+  const std::chrono::duration<G4double> elapsed =
+      std::chrono::steady_clock::now() - fLastWrite;
+  if (!fWriting && elapsed.count() >= fInterval / s) {
+    Write(lock);
+  }
+}
+
+void Checkpoint::RemoveFile(G4int file)
+{
+  // The file descriptor may be in the hands of a checkpoint being written
+  std::unique_lock<std::mutex> lock(fMutex);
+  fWriteDone.wait(lock, [this] { return !fWriting; });
+  const int fd    = fFiles[file].fd;
+  fFiles[file].fd = -1;
+  lock.unlock();
+
+  // The final checkpoint no longer syncs this file, its blocks must be on
+  // disk before the run is marked complete
+  if (fd >= 0 && ::fdatasync(fd) != 0) {
+    lock.lock();
+    fWriteFailed = true;
+  }
+}
+
+std::vector<Checkpoint::Range> Checkpoint::ToRanges(std::vector<i64> events)
+{
+  std::sort(events.begin(), events.end());
+
+  std::vector<Range> ranges;
+  for (const auto event : events) {
+    if (!ranges.empty() && ranges.back().second + 1 >= event) {
+      ranges.back().second = event;
+    } else {
+      ranges.emplace_back(event, event);
+    }
+  }
+  return ranges;
+}
+
+void Checkpoint::AddRanges(std::vector<Range>& done,
+                           const std::vector<Range>& ranges)
+{
+  for (const auto& range : ranges) {
+    // First range that ends at most one event before this one starts
+    auto first = std::lower_bound(
+        done.begin(), done.end(), range.first,
+        [](const Range& r, i64 event) { return r.second + 1 < event; });
+    if (first == done.end() || first->first > range.second + 1) {
+      done.insert(first, range);
+      continue;
+    }
+    // Absorb every range it touches into the first one
+    auto last = first;
+    while (last + 1 != done.end() && (last + 1)->first <= range.second + 1) {
+      ++last;
+    }
+    first->first  = std::min(first->first, range.first);
+    first->second = std::max(last->second, range.second);
+    done.erase(first + 1, last + 1);
+  }
+}
+
+G4bool Checkpoint::IsComplete() const
+{
+  if (fNEvents == 0) {
+    return true;
+  }
+  return fDone.size() == 1 && fDone.front().first <= fEventOffset &&
+         fDone.front().second >= fEventOffset + fNEvents - 1;
+}
+
+G4String Checkpoint::Format() const
+{
+  std::ostringstream os;
+  os << kCheckpointMagic << ' ' << kCheckpointVersion << '\n'
+     << "complete " << IsComplete() << '\n'
+     << "seed " << fSeed << '\n'
+     << "run " << fRunIndex << '\n'
+     << "offset " << fEventOffset << '\n'
+     << "events " << fNEvents << '\n'
+     << "resumes " << fResumes << '\n'
+     << "trigger " << fAccepted << ' ' << fRejected << ' ' << fAborted
+     << '\n'
+     << "output " << fOutputName << '\n'
+     << "analysis " << fAnalysisName << '\n'
+     << "scoring " << fScoringName << '\n'
+     << "done " << fDone.size() << '\n';
+  for (const auto& range : fDone) {
+    os << range.first << ' ' << range.second << '\n';
+  }
+  for (const auto& file : fFiles) {
+    os << "file " << file.blocks.size() << ' ' << file.end << ' '
+       << file.path << '\n';
+    for (const auto& block : file.blocks) {
+      os << block.offset << ' ' << block.nRows << ' ' << block.nEvents << ' '
+         << block.firstEvent << '\n';
+    }
+  }
+  return os.str();
+}
+
+void Checkpoint::Write(std::unique_lock<std::mutex>& lock)
+{
+  fWriteDone.wait(lock, [this] { return !fWriting; });
+  fWriting         = true;
+  const auto start = std::chrono::steady_clock::now();
+
+  // Everything reported so far, the files stay open until fWriting is reset
+  const G4String text    = Format();
+  const G4String name    = fFileName;
+  std::vector<int> fds;
+  for (const auto& file : fFiles) {
+    if (file.fd >= 0) {
+      fds.push_back(file.fd);
+    }
+  }
+  lock.unlock();
+
+  // The checkpoint may not promise more than the files hold
+  for (const auto fd : fds) {
+    ::fdatasync(fd);
+  }
+
+  // Replace the previous checkpoint only once the new one is complete
+  const G4String tmpName = name + ".tmp";
+  std::ofstream out(tmpName, std::ios::trunc);
+  out << text;
+  out.close();
+  const G4bool failed =
+      !out || std::rename(tmpName.c_str(), name.c_str()) != 0;
+
+  lock.lock();
+  fWriting   = false;
+  fLastWrite = std::chrono::steady_clock::now();
+  const std::chrono::duration<G4double> elapsed = fLastWrite - start;
+  fWrites += 1;
+  fWriteTime += elapsed.count();
+  fWriteFailed = fWriteFailed || failed;
+  fWriteDone.notify_all();
+}
+
+G4bool Checkpoint::Repair(const File& file)
+{
+  if (::truncate(file.path.c_str(), file.end) != 0) {
+    return false;
+  }
+  auto* out = std::fopen(file.path.c_str(), "r+b");
+  if (!out) {
+    return false;
+  }
+  columnar::Trailer trailer{};
+  trailer.nBlocks     = file.blocks.size();
+  trailer.indexOffset = file.end;
+  std::memcpy(trailer.magic, columnar::kTrailerMagic, sizeof(trailer.magic));
+
+  const std::size_t nBlocks = file.blocks.size();
+  const G4bool written =
+      std::fseek(out, 0, SEEK_END) == 0 &&
+      std::fwrite(file.blocks.data(), sizeof(columnar::BlockIndexEntry),
+                  nBlocks, out) == nBlocks &&
+      std::fwrite(&trailer, sizeof(trailer), 1, out) == 1;
+  return std::fclose(out) == 0 && written;
+}
+
+void Checkpoint::Resume(const G4String& fileName)
+{
+  std::ifstream in(fileName);
+  std::string key, magic;
+  G4int version = 0, complete = 0, nRanges = 0;
+  G4long seed = 0;
+  G4int runIndex = 0, nEvents = 0, resumes = 0;
+  G4long eventOffset = 0;
+  G4long accepted = 0, rejected = 0, aborted = 0;
+  std::string outputName, analysisName, scoringName;
+  in >> magic >> version >> key >> complete >> key >> seed >> key >>
+      runIndex >> key >> eventOffset >> key >> nEvents >> key >> resumes >>
+      key >> accepted >> rejected >> aborted >> key >> outputName >> key >>
+      analysisName >> key >> scoringName >> key >> nRanges;
+
+  std::vector<Range> done;
+  for (G4int i = 0; in && i < nRanges; ++i) {
+    Range range(0, -1);
+    in >> range.first >> range.second;
+    done.push_back(range);
+  }
+
+  std::vector<File> files;
+  std::size_t nBlocks = 0;
+  while (in >> key >> nBlocks) {
+    File file{"", -1, 0, std::vector<columnar::BlockIndexEntry>(nBlocks)};
+    in >> file.end;
+    std::getline(in >> std::ws, file.path);
+    for (auto& block : file.blocks) {
+      in >> block.offset >> block.nRows >> block.nEvents >> block.firstEvent;
+    }
+    files.push_back(file);
+  }
+
+  if (magic != kCheckpointMagic || version != kCheckpointVersion ||
+      !in.eof()) {
+    G4ExceptionDescription msg;
+    msg << fileName << " is not a readable checkpoint, nothing is resumed";
+    G4Exception("Checkpoint::Resume()", "MyCode0016", JustWarning, msg);
+    return;
+  }
+
+  // Close the files of the checkpoint at their last flushed block
+  for (const auto& file : files) {
+    if (!Repair(file)) {
+      G4ExceptionDescription msg;
+      msg << "Cannot close " << file.path << " at its checkpoint";
+      G4Exception("Checkpoint::Resume()", "MyCode0016", JustWarning, msg);
+    }
+  }
+
+  // The events of the run that are in none of the files
+  std::vector<G4long> pending;
+  auto next = done.begin();
+  for (G4long event = eventOffset; event < eventOffset + nEvents; ++event) {
+    while (next != done.end() && next->second < event) {
+      ++next;
+    }
+    if (next == done.end() || next->first > event) {
+      pending.push_back(event);
+    }
+  }
+
+  G4cout << "INFO: resuming run " << runIndex << " from " << fileName << ", "
+         << pending.size() << " of " << nEvents << " events left, "
+         << accepted << " accepted and " << rejected
+         << " rejected by the trigger" << G4endl;
+  if (complete || pending.empty()) {
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(fMutex);
+    fSeed         = seed;
+    fRunIndex     = runIndex;
+    fEventOffset  = eventOffset;
+    fNEvents      = nEvents;
+    fResumes      = resumes + 1;
+    fAccepted     = accepted;
+    fRejected     = rejected;
+    fAborted      = aborted;
+    fOutputName   = outputName;
+    fAnalysisName = analysisName;
+    fScoringName  = scoringName;
+    fDone         = done;
+    fFiles        = files;
+    fEnabled      = true;
+    fResuming     = true;
+    fUserSeed     = fEventSeeder->GetSeed();
+    // The setting itself, negative for the Geant4 run IDs
+    fUserRunIndex = fEventSeeder->GetRunIndex(-1);
+  }
+
+  fEventSeeder->SetSeed(seed);
+  fEventSeeder->SetRunIndex(runIndex);
+  fEventSeeder->SetEventList(pending);
+
+  // New outputs next to the closed ones, BeginRun takes the lock again
+  auto* UImanager       = G4UImanager::GetUIpointer();
+  const G4String suffix = "_resume" + std::to_string(fResumes);
+  UImanager->ApplyCommand("/muon_lab/output/fileName " + outputName + suffix);
+  UImanager->ApplyCommand("/analysis/setFileName " + analysisName + suffix);
+  UImanager->ApplyCommand("/muon_lab/scoring/fileName " + scoringName +
+                          suffix);
+  // The grid of the crashed run was never dumped
+  const G4String scoring =
+      UImanager->GetCurrentValues("/muon_lab/scoring/enable");
+  if (G4UIcommand::ConvertToBool(scoring.c_str())) {
+    G4cout << "INFO: the voxel scoring of the resumed run only sums its "
+           << pending.size() << " events, the grid of the crashed run is lost"
+           << G4endl;
+  }
+  UImanager->ApplyCommand("/run/beamOn " + std::to_string(pending.size()));
+}
+
+void Checkpoint::DefineCommands()
+{
+  fMessenger = new G4GenericMessenger(this, "/muon_lab/checkpoint/",
+                                      "Checkpoints of the runs");
+
+  // The workers read this object directly, nothing to broadcast
+  auto& enableCmd = fMessenger->DeclareProperty(
+      "enable", fEnabled, "Write checkpoints of the next runs");
+  enableCmd.SetParameterName("flag", false);
+  enableCmd.SetStates(G4State_PreInit, G4State_Idle);
+  enableCmd.command->SetToBeBroadcasted(false);
+
+  auto& fileCmd =
+      fMessenger->DeclareProperty("file", fFileName, "Checkpoint file");
+  fileCmd.SetParameterName("file", false);
+  fileCmd.SetStates(G4State_PreInit, G4State_Idle);
+  fileCmd.command->SetToBeBroadcasted(false);
+
+  auto& intervalCmd = fMessenger->DeclarePropertyWithUnit(
+      "interval", "s", fInterval,
+      "Minimum time between two checkpoints, which sync the output files");
+  intervalCmd.SetParameterName("interval", false);
+  intervalCmd.SetRange("interval>=0.");
+  intervalCmd.SetStates(G4State_PreInit, G4State_Idle);
+  intervalCmd.command->SetToBeBroadcasted(false);
+
+  auto& resumeCmd = fMessenger->DeclareMethod(
+      "resume", &Checkpoint::Resume,
+      "Close the files of a checkpoint and simulate the missing events");
+  resumeCmd.SetParameterName("file", false);
+  resumeCmd.SetStates(G4State_Idle);
+  resumeCmd.command->SetToBeBroadcasted(false);
+}
@@ -0,0 +1,150 @@
+#include "CoincidenceTrigger.hh"
+#include "ScintillatorSD.hh"
+
+#include <G4Exception.hh>
+#include <G4GenericMessenger.hh>
+#include <G4SystemOfUnits.hh>
+#include <G4UnitsTable.hh>
+
+#include <algorithm>
+#include <cfloat>
+#include <cstdlib>
+#include <sstream>
+
+CoincidenceTrigger::CoincidenceTrigger()
+    : fMessenger(nullptr), fEnabled(false), fEarlyAbort(true),
+      fWindow(100. * ns), fChannels{0, 1, 2}, fDefaultThreshold(0.5 * MeV),
+      fThresholds()
+{
+  DefineCommands();
+}
+
+CoincidenceTrigger::~CoincidenceTrigger() { delete fMessenger; }
+
+G4double CoincidenceTrigger::GetThreshold(G4int channel) const
+{
+  const auto threshold = fThresholds.find(channel);
+  return threshold != fThresholds.end() ? threshold->second
+                                        : fDefaultThreshold;
+}
+
+G4bool CoincidenceTrigger::Accept(const ScintillatorSD& sd) const
+{
+  G4double first = DBL_MAX, last = -DBL_MAX;
+  for (const auto channel : fChannels) {
+    if (channel >= sd.GetNumberOfChannels() ||
+        sd.GetDeposit(channel) < GetThreshold(channel)) {
+      return false;
+    }
+    first = std::min(first, sd.GetFirstTime(channel));
+    last  = std::max(last, sd.GetFirstTime(channel));
+  }
+  return fChannels.empty() || last - first <= fWindow;
+}
+
+G4bool CoincidenceTrigger::IsReachable(const ScintillatorSD& sd,
+                                       G4double budget) const
+{
+  for (const auto channel : fChannels) {
+    if (channel >= sd.GetNumberOfChannels() ||
+        sd.GetDeposit(channel) + budget < GetThreshold(channel)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void CoincidenceTrigger::SetChannels(const G4String& channels)
+{
+  std::vector<G4int> parsed;
+  std::istringstream is(channels);
+  G4int channel;
+  while (is >> channel) {
+    parsed.push_back(channel);
+  }
+  if (!is.eof() || std::any_of(parsed.begin(), parsed.end(),
+                               [](G4int c) { return c < 0; })) {
+    G4ExceptionDescription msg;
+    msg << "Invalid trigger channels \"" << channels
+        << "\", the channels are unchanged";
+    G4Exception("CoincidenceTrigger::SetChannels()", "MyCode0017",
+                JustWarning, msg);
+    return;
+  }
+  std::sort(parsed.begin(), parsed.end());
+  parsed.erase(std::unique(parsed.begin(), parsed.end()), parsed.end());
+  fChannels = parsed;
+}
+
+void CoincidenceTrigger::SetThreshold(const G4String& setting)
+{
+  std::istringstream is(setting);
+  std::string channel, unit;
+  G4double value = 0.;
+  is >> channel >> value >> unit;
+
+  char* end       = nullptr;
+  const G4long id = std::strtol(channel.c_str(), &end, 10);
+  const G4bool valid =
+      !is.fail() && value >= 0. &&
+      G4UnitDefinition::GetCategory(unit) == "Energy" &&
+      (channel == "all" || (!channel.empty() && *end == '\0' && id >= 0));
+  if (!valid) {
+    G4ExceptionDescription msg;
+    msg << "Invalid trigger threshold \"" << setting << "\"" << G4endl;
+    msg << "Use <channel|all> <value> <unit>";
+    G4Exception("CoincidenceTrigger::SetThreshold()", "MyCode0017",
+                JustWarning, msg);
+    return;
+  }
+
+  value *= G4UnitDefinition::GetValueOf(unit);
+  if (channel == "all") {
+    fDefaultThreshold = value;
+    fThresholds.clear();
+  } else {
+    fThresholds[id] = value;
+  }
+}
+
+void CoincidenceTrigger::DefineCommands()
+{
+  fMessenger = new G4GenericMessenger(this, "/muon_lab/trigger/",
+                                      "Coincidence trigger");
+
+  // The workers read this object directly, nothing to broadcast
+  auto& enableCmd = fMessenger->DeclareProperty(
+      "enable", fEnabled, "Only write the events that pass the trigger");
+  enableCmd.SetParameterName("flag", false);
+  enableCmd.SetStates(G4State_PreInit, G4State_Idle);
+  enableCmd.command->SetToBeBroadcasted(false);
+
+  auto& abortCmd = fMessenger->DeclareProperty(
+      "earlyAbort", fEarlyAbort,
+      "Abort an event once it cannot pass the trigger any more");
+  abortCmd.SetParameterName("flag", false);
+  abortCmd.SetStates(G4State_PreInit, G4State_Idle);
+  abortCmd.command->SetToBeBroadcasted(false);
+
+  auto& channelsCmd = fMessenger->DeclareMethod(
+      "channels", &CoincidenceTrigger::SetChannels,
+      "Scintillator channels required in coincidence, space separated");
+  channelsCmd.SetParameterName("channels", false);
+  channelsCmd.SetStates(G4State_PreInit, G4State_Idle);
+  channelsCmd.command->SetToBeBroadcasted(false);
+
+  auto& windowCmd = fMessenger->DeclarePropertyWithUnit(
+      "window", "ns", fWindow,
+      "Largest time between the first deposits of the required channels");
+  windowCmd.SetParameterName("window", false);
+  windowCmd.SetRange("window>=0.");
+  windowCmd.SetStates(G4State_PreInit, G4State_Idle);
+  windowCmd.command->SetToBeBroadcasted(false);
+
+  auto& thresholdCmd = fMessenger->DeclareMethod(
+      "threshold", &CoincidenceTrigger::SetThreshold,
+      "Energy deposit a channel needs: <channel|all> <value> <unit>");
+  thresholdCmd.SetParameterName("setting", false);
+  thresholdCmd.SetStates(G4State_PreInit, G4State_Idle);
+  thresholdCmd.command->SetToBeBroadcasted(false);
+}
@@ -0,0 +1,110 @@
+#include "ColumnarOutput.hh"
+#include "ColumnarFormat.hh"
+
+#include <G4Exception.hh>
+#include <G4GenericMessenger.hh>
+
+#include <algorithm>
+#include <sstream>
+
+ColumnarOutput::ColumnarOutput()
+    : fMessenger(nullptr), fEnabled(true), fFileName("hits"),
+      fBlockRows(1 << 16), fBlockEvents(1 << 16), fBuffers(2), fNtuple(true)
+{
+  SetColumns("all");
+  DefineCommands();
+}
+
+ColumnarOutput::~ColumnarOutput() { delete fMessenger; }
+
+G4String ColumnarOutput::GetPath(G4int run, G4int thread) const
+{
+  std::ostringstream os;
+  os << fFileName << "_run" << run << "_t" << thread << ".mlc";
+  return os.str();
+}
+
+void ColumnarOutput::SetColumns(const G4String& columns)
+{
+  std::vector<std::size_t> fields;
+  std::istringstream is(columns);
+  std::string name;
+  while (is >> name) {
+    if (name == "all") {
+      for (std::size_t i = 0; i < columnar::kNFields; ++i) {
+        fields.push_back(i);
+      }
+      continue;
+    }
+
+    const auto field = columnar::FindField(name);
+    if (field == columnar::kNFields) {
+      G4ExceptionDescription msg;
+      msg << "Unknown column " << name << ", the columns are unchanged";
+      G4Exception("ColumnarOutput::SetColumns()", "MyCode0013", JustWarning,
+                  msg);
+      return;
+    }
+    fields.push_back(field);
+  }
+
+  // Keep the order of Particles_t and every column once
+  std::sort(fields.begin(), fields.end());
+  fields.erase(std::unique(fields.begin(), fields.end()), fields.end());
+  fFields = fields;
+}
+
+void ColumnarOutput::DefineCommands()
+{
+  fMessenger = new G4GenericMessenger(this, "/muon_lab/output/",
+                                      "Columnar hit output");
+
+  // The workers read this object directly, nothing to broadcast
+  auto& enableCmd = fMessenger->DeclareProperty(
+      "columnar", fEnabled, "Write the hits to per-thread columnar files");
+  enableCmd.SetParameterName("flag", false);
+  enableCmd.SetStates(G4State_PreInit, G4State_Idle);
+  enableCmd.command->SetToBeBroadcasted(false);
+
+  auto& fileCmd = fMessenger->DeclareProperty(
+      "fileName", fFileName, "Prefix of the columnar files");
+  fileCmd.SetParameterName("name", false);
+  fileCmd.SetStates(G4State_PreInit, G4State_Idle);
+  fileCmd.command->SetToBeBroadcasted(false);
+
+  auto& columnsCmd = fMessenger->DeclareMethod(
+      "columns", &ColumnarOutput::SetColumns,
+      "Particles_t columns to write, space separated, or all");
+  columnsCmd.SetParameterName("columns", false);
+  columnsCmd.SetStates(G4State_PreInit, G4State_Idle);
+  columnsCmd.command->SetToBeBroadcasted(false);
+
+  auto& blockCmd = fMessenger->DeclareProperty(
+      "blockRows", fBlockRows, "Hits per block of the columnar files");
+  blockCmd.SetParameterName("rows", false);
+  blockCmd.SetRange("rows>0");
+  blockCmd.SetStates(G4State_PreInit, G4State_Idle);
+  blockCmd.command->SetToBeBroadcasted(false);
+
+  auto& eventsCmd = fMessenger->DeclareProperty(
+      "blockEvents", fBlockEvents,
+      "Most events per block, for events with few or no hits");
+  eventsCmd.SetParameterName("events", false);
+  eventsCmd.SetRange("events>0");
+  eventsCmd.SetStates(G4State_PreInit, G4State_Idle);
+  eventsCmd.command->SetToBeBroadcasted(false);
+
+  auto& buffersCmd = fMessenger->DeclareProperty(
+      "buffers", fBuffers,
+      "Blocks in flight per thread, the event loop waits when all are queued");
+  buffersCmd.SetParameterName("n", false);
+  buffersCmd.SetRange("n>=2");
+  buffersCmd.SetStates(G4State_PreInit, G4State_Idle);
+  buffersCmd.command->SetToBeBroadcasted(false);
+
+  auto& ntupleCmd = fMessenger->DeclareProperty(
+      "ntuple", fNtuple, "Also fill the Scintillator ntuple");
+  ntupleCmd.SetParameterName("flag", false);
+  ntupleCmd.SetStates(G4State_PreInit, G4State_Idle);
+  ntupleCmd.command->SetToBeBroadcasted(false);
+}
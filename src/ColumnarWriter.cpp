@@ -0,0 +1,266 @@
+#include "ColumnarWriter.hh"
+#include "Checkpoint.hh"
+
+#include <G4Exception.hh>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+namespace {
+const std::size_t kBufferSize = 4 << 20;
+const char kPadding[8]        = {};
+} // namespace
+
+ColumnarWriter::ColumnarWriter()
+    : fFile(nullptr), fWriteFailed(false), fCheckpoint(nullptr),
+      fCheckpointFile(-1), fBlockRows(0), fBlockEvents(0), fOffset(0),
+      fFilling(nullptr), fStop(false)
+{
+}
+
+ColumnarWriter::~ColumnarWriter() { Close(); }
+
+G4bool ColumnarWriter::Open(const G4String& path, G4int run, G4int thread,
+                            const std::vector<std::size_t>& fields,
+                            std::size_t blockRows, std::size_t blockEvents,
+                            std::size_t nBuffers, Checkpoint* checkpoint)
+{
+  Close();
+
+  fFile = std::fopen(path.c_str(), "wb");
+  if (!fFile) {
+    G4ExceptionDescription msg;
+    msg << "Cannot open " << path << ", no columnar output for this run";
+    G4Exception("ColumnarWriter::Open()", "MyCode0014", JustWarning, msg);
+    return false;
+  }
+  fBuffer.resize(kBufferSize);
+  std::setvbuf(fFile, fBuffer.data(), _IOFBF, fBuffer.size());
+
+  fPath        = path;
+  fWriteFailed = false;
+  fFields      = fields;
+  fBlockRows   = blockRows;
+  fBlockEvents = blockEvents;
+  fOffset      = 0;
+  fIndex.clear();
+  fStats = Stats();
+
+  columnar::FileHeader header{};
+  std::memcpy(header.magic, columnar::kFileMagic, sizeof(header.magic));
+  header.version  = columnar::kVersion;
+  header.nColumns = fFields.size();
+  header.run      = run;
+  header.thread   = thread;
+  Write(&header, sizeof(header));
+
+  for (const auto field : fFields) {
+    columnar::ColumnDesc column{};
+    std::strncpy(column.name, columnar::kFields[field].name,
+                 sizeof(column.name) - 1);
+    column.type  = columnar::kFields[field].type;
+    column.field = field;
+    Write(&column, sizeof(column));
+  }
+
+  fCheckpoint = checkpoint && checkpoint->IsEnabled() ? checkpoint : nullptr;
+  if (fCheckpoint) {
+    std::fflush(fFile);
+    fCheckpointFile = fCheckpoint->AddFile(path, ::fileno(fFile), fOffset);
+    if (fCheckpointFile < 0) {
+      fCheckpoint = nullptr;
+    }
+  }
+
+  // The buffers keep their capacity from run to run
+  fBatches.resize(std::max<std::size_t>(nBuffers, 2));
+  fFree.clear();
+  for (auto& batch : fBatches) {
+    batch.hits.Reserve(blockRows);
+    fFree.push_back(&batch);
+  }
+  fFilling = fFree.back();
+  fFree.pop_back();
+
+  fStop   = false;
+  fWriter = std::thread(&ColumnarWriter::Run, this);
+  return true;
+}
+
+void ColumnarWriter::AddEvent(G4long eventIndex, G4double weight,
+                              const pft::Particles_t& hits)
+{
+  const std::size_t nRows = hits.det_id.size();
+  auto& batch             = *fFilling;
+  for (const auto field : fFields) {
+    columnar::AppendColumn(batch.hits, field,
+                           columnar::ColumnData(hits, field), nRows);
+  }
+  batch.events.push_back(eventIndex);
+  batch.weights.push_back(weight);
+  batch.hitEnd.push_back((batch.hitEnd.empty() ? 0 : batch.hitEnd.back()) +
+                         nRows);
+
+  // Events without hits still fill the event columns
+  if (batch.hitEnd.back() >= fBlockRows ||
+      batch.events.size() + batch.rejected.size() >= fBlockEvents) {
+    Submit(true);
+  }
+}
+
+void ColumnarWriter::AddRejected(G4long eventIndex, G4bool aborted)
+{
+  if (!fCheckpoint) {
+    return;
+  }
+  auto& batch = *fFilling;
+  batch.rejected.push_back(eventIndex);
+  batch.aborted += aborted;
+  if (batch.events.size() + batch.rejected.size() >= fBlockEvents) {
+    Submit(true);
+  }
+}
+
+void ColumnarWriter::Submit(G4bool wait)
+{
+  std::unique_lock<std::mutex> lock(fMutex);
+  fFull.push_back(fFilling);
+  fFilling = nullptr;
+  fStats.blocks += 1;
+  fStats.queueDepth += fFull.size();
+  fFullCondition.notify_one();
+  if (!wait) {
+    return;
+  }
+
+  // Backpressure: every buffer is queued, wait for the disk
+  if (fFree.empty()) {
+    const auto start = std::chrono::steady_clock::now();
+    fFreeCondition.wait(lock, [this] { return !fFree.empty(); });
+    const std::chrono::duration<G4double> waited =
+        std::chrono::steady_clock::now() - start;
+    fStats.stalls += 1;
+    fStats.stallTime += waited.count();
+  }
+  fFilling = fFree.back();
+  fFree.pop_back();
+}
+
+void ColumnarWriter::Run()
+{
+  std::unique_lock<std::mutex> lock(fMutex);
+  while (true) {
+    fFullCondition.wait(lock, [this] { return fStop || !fFull.empty(); });
+    if (fFull.empty()) {
+      return;
+    }
+    auto* batch = fFull.front();
+    fFull.pop_front();
+
+    lock.unlock();
+    WriteBlock(*batch);
+    lock.lock();
+
+    fFree.push_back(batch);
+    fFreeCondition.notify_one();
+  }
+}
+
+void ColumnarWriter::WriteBlock(Batch& batch)
+{
+  // Only rejected events, nothing goes to the file
+  if (batch.events.empty()) {
+    fCheckpoint->BlockWritten(fCheckpointFile, nullptr, fOffset, batch.events,
+                              batch.rejected, batch.aborted);
+    batch.rejected.clear();
+    batch.aborted = 0;
+    return;
+  }
+
+  const u64 nEvents = batch.events.size();
+  const u64 nRows   = batch.hitEnd.back();
+
+  columnar::BlockHeader header{};
+  header.magic    = columnar::kBlockMagic;
+  header.nColumns = fFields.size();
+  header.nRows    = nRows;
+  header.nEvents  = nEvents;
+  header.size =
+      sizeof(header) + nEvents * (sizeof(i64) + sizeof(f64) + sizeof(u64));
+  for (const auto field : fFields) {
+    const auto type = columnar::kFields[field].type;
+    header.size += columnar::Padded(nRows * columnar::TypeSize(type));
+  }
+
+  fIndex.push_back({fOffset, nRows, nEvents, batch.events.front()});
+
+  Write(&header, sizeof(header));
+  Write(batch.events.data(), nEvents * sizeof(i64));
+  Write(batch.weights.data(), nEvents * sizeof(f64));
+  Write(batch.hitEnd.data(), nEvents * sizeof(u64));
+  for (const auto field : fFields) {
+    const u64 bytes =
+        nRows * columnar::TypeSize(columnar::kFields[field].type);
+    Write(columnar::ColumnData(batch.hits, field), bytes);
+    Write(kPadding, columnar::Padded(bytes) - bytes);
+  }
+
+  // The checkpoint may count these events as done once they left stdio
+  if (fCheckpoint && std::fflush(fFile) == 0 && !fWriteFailed) {
+    fCheckpoint->BlockWritten(fCheckpointFile, &fIndex.back(), fOffset,
+                              batch.events, batch.rejected, batch.aborted);
+  }
+
+  batch.hits.ClearVecs();
+  batch.events.clear();
+  batch.weights.clear();
+  batch.hitEnd.clear();
+  batch.rejected.clear();
+  batch.aborted = 0;
+}
+
+// Called by the writer thread, errors are reported by Close
+void ColumnarWriter::Write(const void* data, std::size_t bytes)
+{
+  if (bytes > 0 && std::fwrite(data, 1, bytes, fFile) != bytes) {
+    fWriteFailed = true;
+  }
+  fOffset += bytes;
+}
+
+void ColumnarWriter::Close()
+{
+  if (!fFile) {
+    return;
+  }
+  if (!fFilling->events.empty() || !fFilling->rejected.empty()) {
+    Submit(false);
+  }
+  {
+    std::lock_guard<std::mutex> lock(fMutex);
+    fStop = true;
+  }
+  fFullCondition.notify_one();
+  fWriter.join();
+  fFilling = nullptr;
+
+  if (fCheckpoint) {
+    fCheckpoint->RemoveFile(fCheckpointFile);
+    fCheckpoint = nullptr;
+  }
+
+  columnar::Trailer trailer{};
+  trailer.nBlocks     = fIndex.size();
+  trailer.indexOffset = fOffset;
+  std::memcpy(trailer.magic, columnar::kTrailerMagic, sizeof(trailer.magic));
+  Write(fIndex.data(), fIndex.size() * sizeof(columnar::BlockIndexEntry));
+  Write(&trailer, sizeof(trailer));
+
+  if (std::fclose(fFile) != 0 || fWriteFailed) {
+    G4ExceptionDescription msg;
+    msg << "Write error on " << fPath << ", the file is incomplete";
+    G4Exception("ColumnarWriter::Close()", "MyCode0014", JustWarning, msg);
+  }
+  fFile = nullptr;
+}
@@ -0,0 +1,197 @@
+#include "CosmicMuonSpectrum.hh"
+
+#include <G4Exception.hh>
+#include <G4SystemOfUnits.hh>
+#include <Randomize.hh>
+
+#include <algorithm>
+#include <cmath>
+
+CosmicMuonSpectrum::CosmicMuonSpectrum()
+    : fMass(0.), fLogEmin(0.), fDLogE(0.), fCosMin(0.), fDCos(0.),
+      fNAngleBins(0), fIntegral(0.), fBiasedFraction(0.)
+{
+}
+
+CosmicMuonSpectrum::~CosmicMuonSpectrum() {}
+
+G4double CosmicMuonSpectrum::Intensity(G4double energy, G4double cosTheta)
+{
+  // Guan et al. parameters for the effective zenith angle
+  constexpr G4double p1 = 0.102573;
+  constexpr G4double p2 = -0.068287;
+  constexpr G4double p3 = 0.958633;
+  constexpr G4double p4 = 0.0407253;
+  constexpr G4double p5 = 0.817285;
+
+  if (cosTheta <= 0.) {
+    return 0.;
+  }
+
+  const G4double c        = cosTheta;
+  const G4double cosStar2 = (c * c + p1 * p1 + p2 * std::pow(c, p3) +
+                             p4 * std::pow(c, p5)) /
+                            (1. + p1 * p1 + p2 + p4);
+  const G4double cosStar = std::sqrt(std::max(cosStar2, 0.));
+  const G4double e       = energy / GeV;
+
+  const G4double lowEnergy =
+      std::pow(e * (1. + 3.64 / (e * std::pow(cosStar, 1.29))), -2.7);
+  const G4double pionTerm = 1. / (1. + 1.1 * e * cosStar / 115.);
+  const G4double kaonTerm = 0.054 / (1. + 1.1 * e * cosStar / 850.);
+
+  return 0.14 * lowEnergy * (pionTerm + kaonTerm);
+}
+
+void CosmicMuonSpectrum::Build(G4double ekinMin, G4double ekinMax,
+                               G4double cosThetaMin, G4double cosThetaMax,
+                               G4double mass, G4int nEnergyBins,
+                               G4int nAngleBins, const Importance& importance)
+{
+  if (ekinMin <= 0. || ekinMax <= ekinMin || cosThetaMin < 0. ||
+      cosThetaMax > 1. || cosThetaMax <= cosThetaMin || nEnergyBins < 1 ||
+      nAngleBins < 1) {
+    G4ExceptionDescription msg;
+    msg << "Invalid cosmic muon spectrum range: E = [" << ekinMin / GeV
+        << ", " << ekinMax / GeV << "] GeV, cos(theta) = [" << cosThetaMin
+        << ", " << cosThetaMax << "]";
+    G4Exception("CosmicMuonSpectrum::Build()", "MyCode0004", FatalException,
+                msg);
+    return;
+  }
+
+  fMass       = mass;
+  fLogEmin    = std::log(ekinMin + mass);
+  fDLogE      = (std::log(ekinMax + mass) - fLogEmin) / nEnergyBins;
+  fCosMin     = cosThetaMin;
+  fDCos       = (cosThetaMax - cosThetaMin) / nAngleBins;
+  fNAngleBins = nAngleBins;
+
+  // Flux through a horizontal plane: dN ~ I(E, theta) cos(theta) dE dcos
+  // with dE = E dlogE on the logarithmic energy grid
+  std::vector<G4double> weights(nEnergyBins * nAngleBins);
+  G4double sum = 0.;
+  for (G4int i = 0; i < nEnergyBins; ++i) {
+    const G4double energy = std::exp(fLogEmin + (i + 0.5) * fDLogE);
+    for (G4int j = 0; j < nAngleBins; ++j) {
+      const G4double cosTheta = fCosMin + (j + 0.5) * fDCos;
+      weights[i * nAngleBins + j] =
+          Intensity(energy, cosTheta) * cosTheta * energy;
+      sum += weights[i * nAngleBins + j];
+    }
+  }
+  fIntegral = sum * fDLogE * fDCos;
+
+  fWeight.clear();
+  fBiasedFraction = 0.;
+  if (!importance || sum <= 0.) {
+    BuildAliasTable(weights);
+    return;
+  }
+
+  // A bin drawn with probability q instead of p carries the weight p / q,
+  // the draws inside a bin are the same as without importance
+  std::vector<G4double> biased(weights.size());
+  std::vector<G4double> factor(weights.size());
+  G4double biasedSum = 0.;
+  for (G4int i = 0; i < nEnergyBins; ++i) {
+    const G4double ekin = std::exp(fLogEmin + (i + 0.5) * fDLogE) - mass;
+    for (G4int j = 0; j < nAngleBins; ++j) {
+      const G4int bin = i * nAngleBins + j;
+      factor[bin]     = importance(ekin, fCosMin + (j + 0.5) * fDCos);
+      biased[bin]     = weights[bin] * factor[bin];
+      biasedSum += biased[bin];
+    }
+  }
+  if (biasedSum <= 0.) {
+    G4ExceptionDescription msg;
+    msg << "The importance of the cosmic muon spectrum vanishes everywhere, "
+        << "the spectrum is sampled without it";
+    G4Exception("CosmicMuonSpectrum::Build()", "MyCode0018", JustWarning,
+                msg);
+    BuildAliasTable(weights);
+    return;
+  }
+
+  fWeight.assign(weights.size(), 0.);
+  for (std::size_t bin = 0; bin < weights.size(); ++bin) {
+    if (biased[bin] > 0.) {
+      fWeight[bin] = biasedSum / (sum * factor[bin]);
+    }
+    if (factor[bin] > 1.) {
+      fBiasedFraction += biased[bin] / biasedSum;
+    }
+  }
+  BuildAliasTable(biased);
+}
+
+void CosmicMuonSpectrum::BuildAliasTable(const std::vector<G4double>& weights)
+{
+  const G4int n = weights.size();
+
+  G4double total = 0.;
+  for (auto w : weights) {
+    total += w;
+  }
+
+  fProb.assign(n, 1.);
+  fAlias.resize(n);
+  for (G4int i = 0; i < n; ++i) {
+    fAlias[i] = i;
+  }
+  if (total <= 0.) {
+    return;
+  }
+
+  // Vose's variant of the alias method
+  std::vector<G4double> scaled(n);
+  std::vector<G4int> small, large;
+  small.reserve(n);
+  large.reserve(n);
+  for (G4int i = 0; i < n; ++i) {
+    scaled[i] = weights[i] * n / total;
+    if (scaled[i] < 1.) {
+      small.push_back(i);
+    } else {
+      large.push_back(i);
+    }
+  }
+
+  while (!small.empty() && !large.empty()) {
+    const G4int s = small.back();
+    small.pop_back();
+    const G4int l = large.back();
+
+    fProb[s]  = scaled[s];
+    fAlias[s] = l;
+    scaled[l] = (scaled[l] + scaled[s]) - 1.;
+    if (scaled[l] < 1.) {
+      large.pop_back();
+      small.push_back(l);
+    }
+  }
+  // Whatever is left is 1 up to rounding
+  for (auto i : large) {
+    fProb[i] = 1.;
+  }
+  for (auto i : small) {
+    fProb[i] = 1.;
+  }
+}
+
+G4double CosmicMuonSpectrum::Sample(G4double& ekin, G4double& cosTheta) const
+{
+  const G4int n   = fProb.size();
+  const G4double u = G4UniformRand() * n;
+  G4int bin        = std::min(static_cast<G4int>(u), n - 1);
+  if (u - bin >= fProb[bin]) {
+    bin = fAlias[bin];
+  }
+
+  const G4int i = bin / fNAngleBins;
+  const G4int j = bin % fNAngleBins;
+
+  ekin     = std::exp(fLogEmin + (i + G4UniformRand()) * fDLogE) - fMass;
+  cosTheta = fCosMin + (j + G4UniformRand()) * fDCos;
+  return fWeight.empty() ? 1. : fWeight[bin];
+}
@@ -0,0 +1,104 @@
+#include "DecayBiasing.hh"
+#include "DecayBiasingOperator.hh"
+#include "RegionSettings.hh"
+
+#include <G4Exception.hh>
+#include <G4GenericMessenger.hh>
+#include <G4LogicalVolume.hh>
+#include <G4LogicalVolumeStore.hh>
+#include <G4Region.hh>
+#include <G4RegionStore.hh>
+#include <G4VPhysicalVolume.hh>
+
+#include <set>
+#include <sstream>
+
+namespace {
+// The volume and its daughters down to the roots of other regions. An
+// operator only applies to the volumes it is attached to, not to their
+// daughters, e.g. the paddles that fill the planes of an array.
+void CollectRegionVolumes(G4LogicalVolume* lv, const G4Region* region,
+                          std::set<G4LogicalVolume*>& volumes)
+{
+  if (!volumes.insert(lv).second) {
+    return;
+  }
+  for (G4int i = 0; i < lv->GetNoDaughters(); ++i) {
+    auto* daughter = lv->GetDaughter(i)->GetLogicalVolume();
+    if (daughter->IsRootRegion() && daughter->GetRegion() != region) {
+      continue;
+    }
+    CollectRegionVolumes(daughter, region, volumes);
+  }
+}
+} // namespace
+
+DecayBiasing::DecayBiasing()
+    : fMessenger(nullptr), fDecayFactor(1.),
+      fVolumes(RegionSettings::GetName(RegionSettings::kAbsorber))
+{
+  DefineCommands();
+}
+
+DecayBiasing::~DecayBiasing() { delete fMessenger; }
+
+void DecayBiasing::Attach() const
+{
+  // Operators register themselves with Geant4 and live as long as the
+  // thread, as in the biasing examples
+  auto* biasingOperator = new DecayBiasingOperator(this);
+
+  std::set<G4LogicalVolume*> volumes;
+  std::istringstream is(fVolumes);
+  std::string name;
+  while (is >> name) {
+    // A region stands for all its volumes, whatever the geometry names
+    auto* region = G4RegionStore::GetInstance()->GetRegion(name, false);
+    if (region) {
+      auto root = region->GetRootLogicalVolumeIterator();
+      for (std::size_t i = 0; i < region->GetNumberOfRootVolumes(); ++i) {
+        CollectRegionVolumes(*root++, region, volumes);
+      }
+      continue;
+    }
+
+    auto* lv = G4LogicalVolumeStore::GetInstance()->GetVolume(name, false);
+    if (!lv) {
+      G4ExceptionDescription msg;
+      msg << "Unknown region or logical volume " << name << ", the muon "
+          << "decays are not biased in it";
+      G4Exception("DecayBiasing::Attach()", "MyCode0019", JustWarning, msg);
+      continue;
+    }
+    volumes.insert(lv);
+  }
+
+  for (auto* lv : volumes) {
+    biasingOperator->AttachTo(lv);
+  }
+}
+
+void DecayBiasing::DefineCommands()
+{
+  fMessenger = new G4GenericMessenger(this, "/muon_lab/bias/",
+                                      "Biasing of the muon decays");
+
+  // The workers read this object directly, nothing to broadcast
+  auto& factorCmd = fMessenger->DeclareProperty(
+      "decayFactor", fDecayFactor,
+      "Factor on the decay in flight cross-section of the muons in the "
+      "biased volumes, 1 is analog");
+  factorCmd.SetParameterName("factor", false);
+  factorCmd.SetRange("factor>0.");
+  factorCmd.SetStates(G4State_PreInit, G4State_Idle);
+  factorCmd.command->SetToBeBroadcasted(false);
+
+  // The operators are attached when the geometry is built
+  auto& volumesCmd = fMessenger->DeclareProperty(
+      "volumes", fVolumes,
+      "Space separated regions or logical volumes where the muon decays "
+      "are biased");
+  volumesCmd.SetParameterName("volumes", false);
+  volumesCmd.SetStates(G4State_PreInit);
+  volumesCmd.command->SetToBeBroadcasted(false);
+}
@@ -0,0 +1,100 @@
+#include "DecayBiasingOperator.hh"
+#include "DecayBiasing.hh"
+
+#include <G4BOptnChangeCrossSection.hh>
+#include <G4BiasingProcessInterface.hh>
+#include <G4BiasingProcessSharedData.hh>
+#include <G4Exception.hh>
+#include <G4MuonMinus.hh>
+#include <G4MuonPlus.hh>
+#include <G4ProcessManager.hh>
+
+#include <cfloat>
+
+DecayBiasingOperator::DecayBiasingOperator(const DecayBiasing* settings)
+    : G4VBiasingOperator("DecayBiasingOperator"), fSettings(settings)
+{
+}
+
+DecayBiasingOperator::~DecayBiasingOperator()
+{
+  for (auto& operation : fOperations) {
+    delete operation.second;
+  }
+}
+
+void DecayBiasingOperator::StartRun()
+{
+  // The wrapped processes are known once the physics is built
+  if (!fOperations.empty()) {
+    return;
+  }
+  const G4ParticleDefinition* muons[] = {G4MuonMinus::Definition(),
+                                         G4MuonPlus::Definition()};
+  for (const auto* muon : muons) {
+    const auto* sharedData =
+        G4BiasingProcessInterface::GetSharedData(muon->GetProcessManager());
+    if (!sharedData) {
+      continue;
+    }
+    for (const auto* process :
+         sharedData->GetPhysicsBiasingProcessInterfaces()) {
+      if (process->GetWrappedProcess()->GetProcessType() != fDecay) {
+        continue;
+      }
+      fOperations[process] = new G4BOptnChangeCrossSection(
+          "DecayXS-" + muon->GetParticleName());
+    }
+  }
+
+  if (fOperations.empty() && fSettings->GetDecayFactor() != 1.) {
+    G4ExceptionDescription msg;
+    msg << "The muon decay is not wrapped for biasing, "
+        << "/muon_lab/bias/decayFactor has no effect";
+    G4Exception("DecayBiasingOperator::StartRun()", "MyCode0019",
+                JustWarning, msg);
+  }
+}
+
+G4VBiasingOperation* DecayBiasingOperator::ProposeOccurenceBiasingOperation(
+    const G4Track*, const G4BiasingProcessInterface* process)
+{
+  const G4double factor = fSettings->GetDecayFactor();
+  const auto it         = fOperations.find(process);
+  if (factor == 1. || it == fOperations.end()) {
+    return nullptr;
+  }
+
+  // A muon at rest has no decay in flight
+  const G4double analogLength =
+      process->GetWrappedProcess()->GetCurrentInteractionLength();
+  if (analogLength > DBL_MAX / 10.) {
+    return nullptr;
+  }
+  const G4double biasedXS = factor / analogLength;
+
+  // A new interaction length is drawn after each decay or at the first
+  // step in the volume, otherwise the one drawn is carried along the track
+  auto* operation      = it->second;
+  const auto* previous = process->GetPreviousOccurenceBiasingOperation();
+  if (previous != operation || operation->GetInteractionOccured()) {
+    operation->SetBiasedCrossSection(biasedXS);
+    operation->Sample();
+  } else {
+    operation->UpdateForStep(process->GetPreviousStepSize());
+    operation->SetBiasedCrossSection(biasedXS);
+    operation->UpdateForStep(0.);
+  }
+  return operation;
+}
+
+void DecayBiasingOperator::OperationApplied(
+    const G4BiasingProcessInterface* process, G4BiasingAppliedCase,
+    G4VBiasingOperation* occurenceOperation, G4double, G4VBiasingOperation*,
+    const G4VParticleChange*)
+{
+  const auto it = fOperations.find(process);
+  if (it != fOperations.end() && it->second == occurenceOperation) {
+    it->second->SetInteractionOccured();
+  }
+}
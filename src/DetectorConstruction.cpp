@@ -4,21 +4,46 @@
 // G4 includes
 #include <G4Box.hh>
 #include <G4LogicalVolume.hh>
-#include <G4MultiFunctionalDetector.hh>
+#include <G4LogicalVolumeStore.hh>
+#include <G4MaterialPropertiesTable.hh>
 #include <G4NistManager.hh>
-#include <G4PSEnergyDeposit.hh>
-#include <G4PSNofSecondary.hh>
+#include <G4PVParameterised.hh>
 #include <G4PVPlacement.hh>
+#include <G4PVReplica.hh>
 #include <G4PhysicalConstants.hh>
 #include <G4RunManager.hh>
 #include <G4SDManager.hh>
-#include <G4SDParticleFilter.hh>
 #include <G4SystemOfUnits.hh>
-#include <G4VPrimitiveScorer.hh>
+#include <G4VPVParameterisation.hh>
 #include <G4VisAttributes.hh>
 
+#include <vector>
+
+namespace {
+// Planes of an array, pitch apart along z around the centre of the array
+class PlaneParameterisation : public G4VPVParameterisation {
+public:
+  PlaneParameterisation(G4int nPlanes, G4double pitch)
+      : fFirstZ(-0.5 * (nPlanes - 1) * pitch), fPitch(pitch)
+  {
+  }
+
+  virtual void ComputeTransformation(const G4int copyNo,
+                                     G4VPhysicalVolume* physVol) const
+  {
+    physVol->SetTranslation(G4ThreeVector(0., 0., fFirstZ + copyNo * fPitch));
+    physVol->SetRotation(nullptr);
+  }
+
+private:
+  G4double fFirstZ;
+  G4double fPitch;
+};
+} // namespace
+
 DetectorConstruction::DetectorConstruction()
-    : G4VUserDetectorConstruction(), fCheckOverlaps(true)
+    : G4VUserDetectorConstruction(), fGeometry(), fHitFilter(),
+      fOpticalModel(), fRegionSettings(), fDecayBiasing()
 {
 }
 
@@ -35,10 +60,47 @@ G4VPhysicalVolume* DetectorConstruction::Construct()
 
 void DetectorConstruction::DefineMaterials()
 {
+  // The NIST materials named by the geometry
   auto* nistManager = G4NistManager::Instance();
-  nistManager->FindOrBuildMaterial("G4_Fe");
-  nistManager->FindOrBuildMaterial("G4_AIR");
-  nistManager->FindOrBuildMaterial("G4_PLASTIC_SC_VINYLTOLUENE");
+  nistManager->FindOrBuildMaterial(fGeometry.GetWorldMaterial());
+  for (const auto& volume : fGeometry.GetVolumes()) {
+    nistManager->FindOrBuildMaterial(volume.material);
+  }
+  auto* scintillator =
+      nistManager->FindOrBuildMaterial("G4_PLASTIC_SC_VINYLTOLUENE");
+
+  // Scintillation properties of a generic vinyltoluene (EJ-200 like)
+  // plastic, used by G4Scintillation and by the fast optical model
+  const G4int nEntries = 7;
+  G4double photonEnergy[nEntries] = {2.00 * eV, 2.50 * eV, 2.75 * eV, 2.92 * eV,
+                                     3.10 * eV, 3.26 * eV, 3.50 * eV};
+  G4double rindex[nEntries]    = {1.58, 1.58, 1.58, 1.58, 1.58, 1.58, 1.58};
+  G4double absLength[nEntries] = {380. * cm, 380. * cm, 380. * cm, 380. * cm,
+                                  380. * cm, 380. * cm, 380. * cm};
+  G4double emission[nEntries]  = {0.0, 0.05, 0.45, 1.0, 0.45, 0.1, 0.0};
+
+  auto* scintillatorMPT = new G4MaterialPropertiesTable();
+  scintillatorMPT->AddProperty("RINDEX", photonEnergy, rindex, nEntries);
+  scintillatorMPT->AddProperty("ABSLENGTH", photonEnergy, absLength, nEntries);
+  scintillatorMPT->AddProperty("FASTCOMPONENT", photonEnergy, emission,
+                               nEntries);
+  scintillatorMPT->AddConstProperty("SCINTILLATIONYIELD", 10000. / MeV);
+  scintillatorMPT->AddConstProperty("RESOLUTIONSCALE", 1.0);
+  scintillatorMPT->AddConstProperty("FASTTIMECONSTANT", 2.1 * ns);
+  scintillatorMPT->AddConstProperty("YIELDRATIO", 1.0);
+  scintillator->SetMaterialPropertiesTable(scintillatorMPT);
+  scintillator->GetIonisation()->SetBirksConstant(0.126 * mm / MeV);
+
+  // The fast optical model takes the material of the scintillators
+  for (const auto& volume : fGeometry.GetVolumes()) {
+    if (volume.kind != GeometryConfig::Kind::Absorber) {
+      scintillator = G4Material::GetMaterial(volume.material, false);
+      break;
+    }
+  }
+  if (scintillator) {
+    fOpticalModel.SetScintillator(scintillator);
+  }
 
   // Print materials
   // G4cout << *(G4Material::GetMaterialTable()) << G4endl;
@@ -46,23 +108,15 @@ void DetectorConstruction::DefineMaterials()
 
 G4VPhysicalVolume* DetectorConstruction::DefineVolumes()
 {
-
   // Get materials
-  auto* defaultMaterial  = G4Material::GetMaterial("G4_AIR");
-  auto* absorberMaterial = G4Material::GetMaterial("G4_Fe");
-  auto* scintillatorMaterial =
-      G4Material::GetMaterial("G4_PLASTIC_SC_VINYLTOLUENE");
-
-  // Envelope parameters
-  G4double env_sizeXY = 20 * cm, env_sizeZ = 50 * cm;
-  // World
-  G4double worldSizeXY = 1.2 * env_sizeXY;
-  G4double worldSizeZ  = 1.2 * env_sizeZ;
-  G4double scintX      = 16 * cm;
-  G4double scintY      = 11 * cm;
-  G4double scintZ      = 2 * cm;
+  auto* defaultMaterial = G4Material::GetMaterial(fGeometry.GetWorldMaterial());
+  G4bool materialsFound = defaultMaterial != nullptr;
+  for (const auto& volume : fGeometry.GetVolumes()) {
+    materialsFound =
+        materialsFound && G4Material::GetMaterial(volume.material, false);
+  }
 
-  if (!defaultMaterial || !absorberMaterial || !scintillatorMaterial) {
+  if (!materialsFound) {
     G4ExceptionDescription msg;
     msg << "Cannot retrieve materials already defined.";
     G4Exception("DetectorConstruction::DefineVolumes()", "MyCode0001",
@@ -72,9 +126,10 @@ G4VPhysicalVolume* DetectorConstruction::DefineVolumes()
   //
   // World
   //
-  auto* worldS =
-      new G4Box("World",                                           // its name
-                worldSizeXY / 2, worldSizeXY / 2, worldSizeZ / 2); // its size
+  const G4double* worldSize = fGeometry.GetWorldSize();
+  auto* worldS = new G4Box("World",                           // its name
+                           worldSize[0] / 2, worldSize[1] / 2, // its size
+                           worldSize[2] / 2);
 
   auto* worldLV = new G4LogicalVolume(worldS,          // its solid
                                       defaultMaterial, // its material
@@ -87,90 +142,128 @@ G4VPhysicalVolume* DetectorConstruction::DefineVolumes()
                                     0,               // its mother  volume
                                     false,           // no boolean operation
                                     0,               // copy number
-                                    fCheckOverlaps); // checking overlaps
+                                    false);          // checked below
 
   worldLV->SetVisAttributes(G4VisAttributes::GetInvisible());
 
-  // The two same scintillators, the top and bottom one
-  auto* scintillatorSolid =
-      new G4Box("scint", scintX / 2, scintY / 2, scintZ / 2);
-
-  auto* scintillatorLV0 =
-      new G4LogicalVolume(scintillatorSolid, scintillatorMaterial, "scintLV0");
-  new G4PVPlacement(0, G4ThreeVector(), scintillatorLV0, "scintPV0", worldLV,
-                    false, 0, fCheckOverlaps);
-
-  auto* scintillatorLV2 =
-      new G4LogicalVolume(scintillatorSolid, scintillatorMaterial, "scintLV2");
-  new G4PVPlacement(0, G4ThreeVector(0., 0., 100.), scintillatorLV2, "scintPV2",
-                    worldLV, false, 0, fCheckOverlaps);
-
-  // scintillator in the middle
-  auto* scintillatorSmallSolid =
-      new G4Box("smallscint", scintX / 2, scintY / 6, scintZ);
-  auto* scintillatorLV1 = new G4LogicalVolume(scintillatorSmallSolid,
-                                              scintillatorMaterial, "scintLV1");
-  new G4PVPlacement(0, G4ThreeVector(0., 0., 3. * scintZ / 2.), scintillatorLV1,
-                    "scintPV1", worldLV, false, 0, fCheckOverlaps);
-
-  // iron plate where the scint0 is positioned
-  auto* absorberSolid =
-      new G4Box("absorber", scintX / 2, scintY / 2, scintZ / 2);
-
-  auto* absorberLV =
-      new G4LogicalVolume(absorberSolid, absorberMaterial, "absorbeLV");
-  new G4PVPlacement(0, G4ThreeVector(0., 0., 100 - scintZ), absorberLV,
-                    "absorberPV", worldLV, false, 0, fCheckOverlaps);
-
-  auto* red    = new G4VisAttributes(G4Colour::Red());
-  auto* yellow = new G4VisAttributes(G4Colour::Yellow());
-  auto* cyan   = new G4VisAttributes(G4Colour::Cyan());
-
+  auto* red  = new G4VisAttributes(G4Colour::Red());
+  auto* cyan = new G4VisAttributes(G4Colour::Cyan());
   red->SetVisibility(true);
-  yellow->SetVisibility(true);
   cyan->SetVisibility(true);
 
-  // red->SetForceSolid();
-  // yellow->SetForceSolid();
-  // cyan->SetForceSolid();
+  // The copy number of each scintillator is its detector id. The first
+  // absorber keeps the historical absorbeLV name.
+  std::vector<G4LogicalVolume*> absorberLVs, scintillatorLVs;
+  std::vector<G4VPhysicalVolume*> placements;
+  for (const auto& volume : fGeometry.GetVolumes()) {
+    if (volume.kind == GeometryConfig::Kind::Array) {
+      scintillatorLVs.push_back(BuildArray(volume, worldLV, cyan, placements));
+      continue;
+    }
+
+    const G4bool scintillator =
+        volume.kind == GeometryConfig::Kind::Scintillator;
+    const G4String index =
+        scintillator || volume.copyNumber > 0
+            ? std::to_string(volume.copyNumber)
+            : "";
+    const G4String name = scintillator ? "scint" : "absorbe";
+
+    auto* solid = new G4Box(name + index, volume.size[0] / 2,
+                            volume.size[1] / 2, volume.size[2] / 2);
+    auto* lv    = new G4LogicalVolume(
+        solid, G4Material::GetMaterial(volume.material), name + "LV" + index);
+    placements.push_back(new G4PVPlacement(
+        0, G4ThreeVector(0., 0., volume.z), lv,
+        (scintillator ? "scintPV" : "absorberPV") + index, worldLV, false,
+        volume.copyNumber, false));
+
+    lv->SetVisAttributes(scintillator ? cyan : red);
+    (scintillator ? scintillatorLVs : absorberLVs).push_back(lv);
+  }
+
+  // Validated geometries are not checked again
+  if (!fGeometry.CheckOverlaps(placements)) {
+    G4ExceptionDescription msg;
+    msg << "The volumes of the geometry overlap, see the overlap report";
+    G4Exception("DetectorConstruction::DefineVolumes()", "MyCode0021",
+                JustWarning, msg);
+  }
 
-  scintillatorLV0->SetVisAttributes(cyan);
-  scintillatorLV1->SetVisAttributes(yellow);
-  scintillatorLV2->SetVisAttributes(cyan);
-  absorberLV->SetVisAttributes(red);
+  // Coarse cuts in the iron, fine cuts in the plastic
+  fRegionSettings.Build(absorberLVs, scintillatorLVs);
 
   // Always return the physical World
   return worldPV;
 }
 
+G4LogicalVolume*
+DetectorConstruction::BuildArray(const GeometryConfig::Volume& volume,
+                                 G4LogicalVolume* motherLV,
+                                 G4VisAttributes* paddleVis,
+                                 std::vector<G4VPhysicalVolume*>& placements)
+{
+  const G4String index = std::to_string(volume.copyNumber);
+  auto* material       = G4Material::GetMaterial(volume.material);
+  const G4double* size = volume.size;
+  const G4double planeX = volume.paddles * size[0];
+  const G4double arrayZ = (volume.planes - 1) * volume.pitch + size[2];
+
+  // Whatever the number of paddles there is one paddle and one plane
+  // volume: the paddles are replicas filling a plane along x and the planes
+  // a parameterised volume in the air box of the array
+  auto* paddleS  = new G4Box("scintPaddle" + index, size[0] / 2,
+                             size[1] / 2, size[2] / 2);
+  auto* paddleLV =
+      new G4LogicalVolume(paddleS, material, "scintPaddleLV" + index);
+  paddleLV->SetVisAttributes(paddleVis);
+
+  auto* planeS  = new G4Box("scintPlane" + index, planeX / 2, size[1] / 2,
+                            size[2] / 2);
+  auto* planeLV =
+      new G4LogicalVolume(planeS, material, "scintPlaneLV" + index);
+  new G4PVReplica("scintPaddlePV" + index, paddleLV, planeLV, kXAxis,
+                  volume.paddles, size[0]);
+
+  auto* arrayS  = new G4Box("scintArray" + index, planeX / 2, size[1] / 2,
+                            arrayZ / 2);
+  auto* arrayLV = new G4LogicalVolume(
+      arrayS, motherLV->GetMaterial(), "scintArrayLV" + index);
+  arrayLV->SetVisAttributes(G4VisAttributes::GetInvisible());
+  planeLV->SetVisAttributes(G4VisAttributes::GetInvisible());
+  placements.push_back(new G4PVParameterised(
+      "scintPlanePV" + index, planeLV, arrayLV, kZAxis, volume.planes,
+      new PlaneParameterisation(volume.planes, volume.pitch)));
+
+  placements.push_back(new G4PVPlacement(
+      0, G4ThreeVector(0., 0., volume.z), arrayLV, "scintArrayPV" + index,
+      motherLV, false, volume.copyNumber, false));
+  return planeLV;
+}
+
 void DetectorConstruction::ConstructSDandField()
 {
   G4SDManager::GetSDMpointer()->SetVerboseLevel(1);
 
-  auto* scint0Detector = new G4MultiFunctionalDetector("Scintillator0");
-  G4SDManager::GetSDMpointer()->AddNewDetector(scint0Detector);
-
-  G4VPrimitiveScorer* primitive = nullptr;
-  primitive                     = new G4PSEnergyDeposit("Edep");
-  scint0Detector->RegisterPrimitive(primitive);
-  SetSensitiveDetector("scintLV0", scint0Detector);
-
-  auto* scint1Detector = new G4MultiFunctionalDetector("Scintillator1");
-  G4SDManager::GetSDMpointer()->AddNewDetector(scint1Detector);
-  primitive = new G4PSEnergyDeposit("Edep");
-  scint1Detector->RegisterPrimitive(primitive);
-  SetSensitiveDetector("scintLV1", scint1Detector);
-
-  auto* scint2Detector = new G4MultiFunctionalDetector("Scintillator2");
-  G4SDManager::GetSDMpointer()->AddNewDetector(scint2Detector);
-  primitive = new G4PSEnergyDeposit("Edep");
-  scint2Detector->RegisterPrimitive(primitive);
-  SetSensitiveDetector("scintLV2", scint2Detector);
-
-  auto* scintSD = new ScintillatorSD("scintillators");
+  // A single detector scores the hits and the total energy deposit of
+  // every scintillator, indexed by copy number
+  auto* scintSD = new ScintillatorSD("scintillators",
+                                    fGeometry.GetNumberOfChannels(),
+                                    &fHitFilter, &fOpticalModel);
   G4SDManager::GetSDMpointer()->AddNewDetector(scintSD);
 
-  SetSensitiveDetector("scintLV0", scintSD);
-  SetSensitiveDetector("scintLV1", scintSD);
-  SetSensitiveDetector("scintLV2", scintSD);
+  for (const auto& volume : fGeometry.GetVolumes()) {
+    const G4String index = std::to_string(volume.copyNumber);
+    if (volume.kind == GeometryConfig::Kind::Scintillator) {
+      SetSensitiveDetector("scintLV" + index, scintSD);
+    } else if (volume.kind == GeometryConfig::Kind::Array) {
+      auto* paddleLV = G4LogicalVolumeStore::GetInstance()->GetVolume(
+          "scintPaddleLV" + index);
+      scintSD->AddArray(paddleLV, volume.copyNumber, volume.paddles);
+      SetSensitiveDetector(paddleLV, scintSD);
+    }
+  }
+
+  // Muon decay enrichment, analog unless /muon_lab/bias/decayFactor is set
+  fDecayBiasing.Attach();
 }
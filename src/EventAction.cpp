@@ -1,141 +1,181 @@
 #include "EventAction.hh"
 #include "Analysis.hh"
+#include "RunAction.hh"
+#include "ScintillatorOpticalModel.hh"
+#include "ScintillatorSD.hh"
+#include "TrackingAction.hh"
 #include "pft.hpp"
 
 #include <G4Event.hh>
-#include <G4HCofThisEvent.hh>
+#include <G4Exception.hh>
+#include <G4PrimaryVertex.hh>
+#include <G4Run.hh>
 #include <G4RunManager.hh>
 #include <G4SDManager.hh>
 #include <G4SystemOfUnits.hh>
-#include <G4THitsCollection.hh>
-#include <G4UnitsTable.hh>
-#include <Randomize.hh>
-
-EventAction::EventAction()
-    : G4UserEventAction(), fScintillator0EdepID(-1), fScintillator1EdepID(-1),
-      fScintillator2EdepID(-1), fScintillatorCollID(-1)
+#include <G4Threading.hh>
+
+#include <algorithm>
+
+EventAction::EventAction(const EventSeeder* eventSeeder,
+                         ProgressLogger* progressLogger,
+                         const CoincidenceTrigger* trigger,
+                         const PMTResponse* pmtResponse)
+    : G4UserEventAction(), fEventSeeder(eventSeeder),
+      fProgressLogger(progressLogger), fTrigger(trigger),
+      fPMTResponse(pmtResponse), fDigitizer(nullptr), fRunAction(nullptr),
+      fTrackingAction(nullptr), fColumnarWriter(nullptr),
+      fNtupleEnabled(true), fScintillatorSD(nullptr),
+      fWeightColumnID(-1), fRunColumnID(-1), fEventColumnID(-1),
+      fDigitColumnID(-1)
 {
+  fDigitizer = new PMTDigitizer(fPMTResponse, &fDigits);
 }
 
-EventAction::~EventAction() {}
-
-G4THitsMap<G4double>* EventAction::GetHitsCollection(G4int hcID,
-                                                     const G4Event* event) const
+void EventAction::BeginOfRun(const ScintillatorOpticalModel& opticalModel)
 {
-  auto hitsCollection = static_cast<G4THitsMap<G4double>*>(
-      event->GetHCofThisEvent()->GetHC(hcID));
+  if (!fPMTResponse->IsEnabled()) {
+    return;
+  }
+  fDigitizer->BeginOfRun();
 
-  if (!hitsCollection) {
+  if (!opticalModel.IsEnabled() && G4Threading::IsMasterThread()) {
     G4ExceptionDescription msg;
-    msg << "Cannot access hc ID" << hcID;
-    G4Exception("EventAction::GetHitsCollection()", "MyCode0003",
-                FatalException, msg);
+    msg << "The PMT digitizer needs the photoelectrons of the fast optical "
+        << "model" << G4endl;
+    msg << "No digits are written without /muon_lab/optical/fastModel true";
+    G4Exception("EventAction::BeginOfRun()", "MyCode0020", JustWarning, msg);
   }
-
-  return hitsCollection;
 }
 
-G4double EventAction::GetSum(G4THitsMap<G4double>* hitsMap) const
-{
-  G4double sumValue = 0.;
-  for (auto it : *hitsMap->GetMap()) {
-    sumValue += *(it.second);
-  }
-  return sumValue;
-}
+EventAction::~EventAction() {}
 
-void EventAction::PrintEventStatistics(G4int i, G4double absoEdep) const
+void EventAction::LogEvent(const G4Event* event) const
 {
-  // Print event statistics
-  G4cout << "   Scintillator " << i << " : total energy: " << std::setw(7)
-         << G4BestUnit(absoEdep, "Energy") << G4endl;
+  ProgressLogger::EventRecord record;
+  record.eventID   = event->GetEventID();
+  record.nHits     = fParticles.det_id.size();
+  record.nChannels = std::min<G4int>(fScintillatorSD->GetNumberOfChannels(),
+                                     ProgressLogger::kMaxChannels);
+  for (G4int i = 0; i < record.nChannels; ++i) {
+    record.edep[i] = fScintillatorSD->GetEdep(i);
+  }
+  fProgressLogger->PushRecord(record);
 }
 
-void EventAction::BeginOfEventAction(const G4Event*)
+void EventAction::BeginOfEventAction(const G4Event* event)
 {
-  fScintillator0EdepID =
-      G4SDManager::GetSDMpointer()->GetCollectionID("Scintillator0/Edep");
-  fScintillator1EdepID =
-      G4SDManager::GetSDMpointer()->GetCollectionID("Scintillator1/Edep");
-  fScintillator2EdepID =
-      G4SDManager::GetSDMpointer()->GetCollectionID("Scintillator2/Edep");
-
-  fScintillatorCollID =
-      G4SDManager::GetSDMpointer()->GetCollectionID("ScintParticleCollection");
+  if (fTrackingAction) {
+    fTrackingAction->BeginEvent(event);
+  }
   fParticles.ClearVecs();
+  fPEChannels.clear();
+  fPhotoelectrons.clear();
+  fDigits.Clear();
 }
 
 void EventAction::EndOfEventAction(const G4Event* event)
 {
-  // Get hist collections IDs
-  if (fScintillator1EdepID < 0) {
-    fScintillator0EdepID =
-        G4SDManager::GetSDMpointer()->GetCollectionID("Scintillator0/Edep");
-    fScintillator1EdepID =
-        G4SDManager::GetSDMpointer()->GetCollectionID("Scintillator1/Edep");
-    fScintillator2EdepID =
-        G4SDManager::GetSDMpointer()->GetCollectionID("Scintillator2/Edep");
-    fScintillatorCollID = G4SDManager::GetSDMpointer()->GetCollectionID(
-        "ScintParticleCollection");
+  // Get the scintillator detector once
+  if (!fScintillatorSD) {
+    fScintillatorSD = static_cast<ScintillatorSD*>(
+        G4SDManager::GetSDMpointer()->FindSensitiveDetector("scintillators"));
   }
 
-  ScintillatorHitsCollection* ScintHC = nullptr;
-  if (event->GetHCofThisEvent()) {
-    ScintHC = static_cast<ScintillatorHitsCollection*>(
-        event->GetHCofThisEvent()->GetHC(fScintillatorCollID));
+  // This is were we get the data from the hit buffer
+  Populate(fParticles, fScintillatorSD->GetHitBuffer());
+
+  // Photoelectrons of the fast optical model, of the touched channels only
+  fPEChannels = fScintillatorSD->GetTouchedChannels();
+  std::sort(fPEChannels.begin(), fPEChannels.end());
+  const auto& photoelectrons = fScintillatorSD->GetPhotoelectrons();
+  fPEChannels.erase(std::remove_if(fPEChannels.begin(), fPEChannels.end(),
+                                   [&photoelectrons](G4int channel) {
+                                     return photoelectrons[channel] == 0;
+                                   }),
+                    fPEChannels.end());
+  for (const G4int channel : fPEChannels) {
+    fPhotoelectrons.push_back(photoelectrons[channel]);
   }
 
-  // This is were we get the data from the HitCollection
-  if (ScintHC) {
-    // Get number of entries
-    G4cout << "We got a HitCollection with nHits: " << ScintHC->entries()
-           << G4endl;
-    // fParticles.Populate(ScintHC);
-    Populate(fParticles, ScintHC);
+  // Events that fail the trigger are only counted, for the normalisation
+  const G4bool aborted  = event->IsAborted();
+  const G4bool accepted = !fTrigger->IsEnabled() ||
+                          (!aborted && fTrigger->Accept(*fScintillatorSD));
+  fRunAction->CountTrigger(accepted, aborted);
+  if (!accepted) {
+    // Done for the checkpoint, which would otherwise simulate it again
+    if (fColumnarWriter) {
+      fColumnarWriter->AddRejected(
+          fEventSeeder->GetEventIndex(event->GetEventID()), aborted);
+    }
+    fProgressLogger->EventDone();
+    return;
   }
 
-  // Get sum values from hits collections
-  auto scint0Edep = GetSum(GetHitsCollection(fScintillator0EdepID, event));
-  auto scint1Edep = GetSum(GetHitsCollection(fScintillator1EdepID, event));
-  auto scint2Edep = GetSum(GetHitsCollection(fScintillator2EdepID, event));
-
   // get analysis manager
   auto analysisManager = G4AnalysisManager::Instance();
 
   // // fill histograms
-  analysisManager->FillH1(0, scint0Edep);
-  analysisManager->FillH1(1, scint1Edep);
-  analysisManager->FillH1(2, scint2Edep);
-  analysisManager->AddNtupleRow(0);
-
-  // print per event (modulo n)
-  auto eventID     = event->GetEventID();
-  auto printModulo = G4RunManager::GetRunManager()->GetPrintProgress();
-  if ((printModulo > 0) && (eventID % printModulo == 0)) {
-    G4cout << "---> End of event: " << eventID << G4endl;
-    PrintEventStatistics(0, scint0Edep);
-    PrintEventStatistics(1, scint1Edep);
-    PrintEventStatistics(2, scint2Edep);
+  // with the total energy deposits accumulated by the sensitive detector,
+  // there are histograms for the first three channels
+  const G4int nHistograms =
+      std::min(3, fScintillatorSD->GetNumberOfChannels());
+  for (G4int i = 0; i < nHistograms; ++i) {
+    analysisManager->FillH1(i, fScintillatorSD->GetEdep(i));
   }
+
+  // weight given to the event by the generator (1 for unbiased modes)
+  G4double weight = 1.;
+  if (event->GetPrimaryVertex()) {
+    weight = event->GetPrimaryVertex()->GetWeight();
+  }
+
+  if (fNtupleEnabled) {
+    analysisManager->FillNtupleDColumn(0, fWeightColumnID, weight);
+
+    // Indices the event was seeded with, enough to simulate it again
+    const auto runID =
+        G4RunManager::GetRunManager()->GetCurrentRun()->GetRunID();
+    analysisManager->FillNtupleIColumn(0, fRunColumnID,
+                                       fEventSeeder->GetRunIndex(runID));
+    analysisManager->FillNtupleIColumn(
+        0, fEventColumnID, fEventSeeder->GetEventIndex(event->GetEventID()));
+    analysisManager->AddNtupleRow(0);
+  }
+
+  // Compact PMT records, the run and event indices as in the hits
+  if (fPMTResponse->IsEnabled()) {
+    fDigitizer->Digitize();
+    const auto runID =
+        G4RunManager::GetRunManager()->GetCurrentRun()->GetRunID();
+    analysisManager->FillNtupleIColumn(2, fDigitColumnID,
+                                       fEventSeeder->GetRunIndex(runID));
+    analysisManager->FillNtupleIColumn(
+        2, fDigitColumnID + 1,
+        fEventSeeder->GetEventIndex(event->GetEventID()));
+    analysisManager->FillNtupleDColumn(2, fDigitColumnID + 2, weight);
+    analysisManager->FillNtupleDColumn(2, fDigitColumnID + 3,
+                                       fDigits.windowStart);
+    analysisManager->AddNtupleRow(2);
+  }
+
+  // Only copied here, the block is written by the writer thread
+  if (fColumnarWriter) {
+    fColumnarWriter->AddEvent(fEventSeeder->GetEventIndex(event->GetEventID()),
+                              weight, fParticles);
+  }
+
+  // Printed by the reporter thread, never from here
+  if (fProgressLogger->IsVerbose()) {
+    LogEvent(event);
+  }
+  fProgressLogger->EventDone();
 }
 
 void EventAction::Populate(pft::Particles_t& par,
-                           const ScintillatorHitsCollection* ScintHC)
+                           ScintillatorHitBuffer& hitBuffer)
 {
-  size_t nHits = ScintHC->entries();
-  par.Reserve(nHits);
-  for (size_t i = 0; i < nHits; i++) {
-    par.det_id.push_back(std::atoi((*ScintHC)[i]->GetScintName().c_str()));
-    par.parent_id.push_back((*ScintHC)[i]->GetParentId());
-    par.trid.push_back((*ScintHC)[i]->GetTrId());
-    par.times.push_back((*ScintHC)[i]->GetTime() / ns);
-    par.edep.push_back((*ScintHC)[i]->GetEdep() / MeV);
-    par.energy.push_back((*ScintHC)[i]->GetE() / MeV);
-    par.posX.push_back((*ScintHC)[i]->GetPos().x());
-    par.posY.push_back((*ScintHC)[i]->GetPos().y());
-    par.posZ.push_back((*ScintHC)[i]->GetPos().z());
-    par.theta.push_back((*ScintHC)[i]->GetPos().theta());
-    par.phi.push_back((*ScintHC)[i]->GetPos().phi());
-    par.trlen.push_back((*ScintHC)[i]->GetTrLen());
-  }
+  // The buffer already holds the columns, hand them over without copies
+  hitBuffer.SwapInto(par);
 }
@@ -0,0 +1,74 @@
+#include "EventSeeder.hh"
+
+#include <G4GenericMessenger.hh>
+#include <Randomize.hh>
+
+EventSeeder::EventSeeder()
+    : fMessenger(nullptr), fSeed(100), fRunIndex(-1), fEventOffset(0),
+      fEventList()
+{
+  DefineCommands();
+}
+
+EventSeeder::~EventSeeder() { delete fMessenger; }
+
+std::uint64_t EventSeeder::SplitMix64(std::uint64_t x)
+{
+  x += 0x9e3779b97f4a7c15ULL;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+
+void EventSeeder::SeedEvent(G4int runID, G4int eventID) const
+{
+  const auto run   = static_cast<std::uint32_t>(GetRunIndex(runID));
+  const auto index = static_cast<std::uint64_t>(GetEventIndex(eventID));
+  const auto event = static_cast<std::uint32_t>(index);
+
+  // Indices past 2^32 get a key of their own, the others keep their seeds
+  std::uint64_t key = SplitMix64(static_cast<std::uint64_t>(fSeed));
+  if (index >> 32) {
+    key = SplitMix64(key ^ (index >> 32));
+  }
+  const std::uint64_t hash =
+      SplitMix64(key ^ ((static_cast<std::uint64_t>(run) << 32) | event));
+
+  // Two non zero 31 bit seeds, enough for MixMax and Ranecu alike
+  long seeds[3] = {static_cast<long>(hash & 0x7fffffff),
+                   static_cast<long>((hash >> 32) & 0x7fffffff), 0};
+  for (G4int i = 0; i < 2; ++i) {
+    if (seeds[i] == 0) {
+      seeds[i] = 1;
+    }
+  }
+  G4Random::setTheSeeds(seeds);
+}
+
+void EventSeeder::DefineCommands()
+{
+  fMessenger =
+      new G4GenericMessenger(this, "/muon_lab/random/", "Event seeding");
+
+  // The workers read this object directly, nothing to broadcast
+  auto& seedCmd = fMessenger->DeclareProperty(
+      "seed", fSeed, "Seed from which the seeds of every event are derived");
+  seedCmd.SetParameterName("seed", false);
+  seedCmd.SetStates(G4State_PreInit, G4State_Idle);
+  seedCmd.command->SetToBeBroadcasted(false);
+
+  auto& runCmd = fMessenger->DeclareProperty(
+      "runIndex", fRunIndex,
+      "Run index used for seeding (negative: the current run ID)");
+  runCmd.SetParameterName("run", false);
+  runCmd.SetStates(G4State_PreInit, G4State_Idle);
+  runCmd.command->SetToBeBroadcasted(false);
+
+  auto& offsetCmd = fMessenger->DeclareProperty(
+      "eventOffset", fEventOffset,
+      "Index of the first event of the next run, for seeding and output");
+  offsetCmd.SetParameterName("offset", false);
+  offsetCmd.SetRange("offset>=0");
+  offsetCmd.SetStates(G4State_PreInit, G4State_Idle);
+  offsetCmd.command->SetToBeBroadcasted(false);
+}
@@ -0,0 +1,156 @@
+#include "ForkedRun.hh"
+#include "Analysis.hh"
+
+#include <G4Exception.hh>
+#include <G4Run.hh>
+#include <G4RunManager.hh>
+#include <G4Timer.hh>
+#include <G4UImanager.hh>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+ForkedRun::ForkedRun(G4int nProcesses) : fNProcesses(nProcesses) {}
+
+ForkedRun::~ForkedRun() {}
+
+G4int ForkedRun::BeamOn(G4long nEvents)
+{
+  auto* UImanager = G4UImanager::GetUIpointer();
+
+  // Builds the physics tables here so that the workers inherit them
+  UImanager->ApplyCommand("/run/beamOn 0");
+
+  // Buffered output would be printed again by every worker
+  G4cout << std::flush;
+  std::cout.flush();
+  std::fflush(nullptr);
+
+  const G4long offset = std::atol(
+      UImanager->GetCurrentValues("/muon_lab/random/eventOffset").c_str());
+
+  struct Worker {
+    pid_t pid;
+    int fd;
+    G4long firstEvent;
+    G4long nEvents;
+  };
+  std::vector<Worker> workers;
+  for (G4int i = 0; i < fNProcesses; ++i) {
+    const G4long first = offset + nEvents * i / fNProcesses;
+    const G4long last  = offset + nEvents * (i + 1) / fNProcesses;
+
+    int fds[2];
+    if (::pipe(fds) != 0) {
+      G4Exception("ForkedRun::BeamOn()", "MyCode0015", FatalException,
+                  "Cannot create the pipe of a worker process");
+    }
+    const pid_t pid = ::fork();
+    if (pid < 0) {
+      G4Exception("ForkedRun::BeamOn()", "MyCode0015", FatalException,
+                  "Cannot fork a worker process");
+    }
+    if (pid == 0) {
+      ::close(fds[0]);
+      for (const auto& worker : workers) {
+        ::close(worker.fd);
+      }
+      RunWorker(i, first, last - first, fds[1]);
+      ::close(fds[1]);
+      return 0;
+    }
+    ::close(fds[1]);
+    workers.push_back({pid, fds[0], first, last - first});
+  }
+
+  // Collect the workers in order, a missing summary means a crash
+  G4long events     = 0;
+  G4double realTime = 0.;
+  G4int failed      = 0;
+  RunAction::Counters counters{};
+  for (std::size_t i = 0; i < workers.size(); ++i) {
+    const auto& worker = workers[i];
+    Summary summary{};
+    const G4bool complete =
+        ::read(worker.fd, &summary, sizeof(summary)) == sizeof(summary);
+    ::close(worker.fd);
+
+    int status = 0;
+    ::waitpid(worker.pid, &status, 0);
+    if (!complete || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+      ++failed;
+      G4ExceptionDescription msg;
+      msg << "Worker process " << i << " (events " << worker.firstEvent
+          << " to " << worker.firstEvent + worker.nEvents - 1 << ") ";
+      if (WIFSIGNALED(status)) {
+        msg << "was killed by signal " << WTERMSIG(status);
+      } else if (WEXITSTATUS(status) != 0) {
+        msg << "exited with status " << WEXITSTATUS(status);
+      } else {
+        msg << "stopped before the end of its run";
+      }
+      G4Exception("ForkedRun::BeamOn()", "MyCode0015", JustWarning, msg);
+      continue;
+    }
+    events += summary.events;
+    realTime = std::max(realTime, summary.realTime);
+    counters += summary.counters;
+  }
+
+  G4cout << "INFO: " << workers.size() - failed << " of " << workers.size()
+         << " processes done, " << events << " events in " << realTime
+         << " s";
+  if (realTime > 0.) {
+    G4cout << ", " << events / realTime << " events/s";
+  }
+  G4cout << G4endl;
+  RunAction::PrintSummaries(counters);
+  return failed > 0 ? 1 : 0;
+}
+
+void ForkedRun::RunWorker(G4int index, G4long firstEvent, G4long nEvents,
+                          int fd)
+{
+  auto* UImanager = G4UImanager::GetUIpointer();
+
+  // Own output files
+  const G4String suffix = "_p" + std::to_string(index);
+  UImanager->ApplyCommand(
+      "/analysis/setFileName " +
+      G4AnalysisManager::Instance()->GetFileName() + suffix);
+  UImanager->ApplyCommand(
+      "/muon_lab/output/fileName " +
+      UImanager->GetCurrentValues("/muon_lab/output/fileName") + suffix);
+  UImanager->ApplyCommand(
+      "/muon_lab/scoring/fileName " +
+      UImanager->GetCurrentValues("/muon_lab/scoring/fileName") + suffix);
+  UImanager->ApplyCommand(
+      "/muon_lab/checkpoint/file " +
+      UImanager->GetCurrentValues("/muon_lab/checkpoint/file") + suffix);
+  UImanager->ApplyCommand("/muon_lab/random/eventOffset " +
+                          std::to_string(firstEvent));
+
+  G4Timer timer;
+  timer.Start();
+  UImanager->ApplyCommand("/run/beamOn " + std::to_string(nEvents));
+  timer.Stop();
+
+  // The counters of the run, merged by the run action of this process
+  auto* runManager = G4RunManager::GetRunManager();
+  const auto* run  = runManager->GetCurrentRun();
+  const auto* runAction =
+      static_cast<const RunAction*>(runManager->GetUserRunAction());
+  Summary summary{run ? run->GetNumberOfEvent() : 0, timer.GetRealElapsed(),
+                  runAction->GetCounters()};
+  if (::write(fd, &summary, sizeof(summary)) != sizeof(summary)) {
+    G4Exception("ForkedRun::RunWorker()", "MyCode0015", JustWarning,
+                "Cannot send the summary to the parent process");
+  }
+}
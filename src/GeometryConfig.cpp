@@ -0,0 +1,245 @@
+#include "GeometryConfig.hh"
+
+#include <G4Exception.hh>
+#include <G4GenericMessenger.hh>
+#include <G4SystemOfUnits.hh>
+#include <G4UnitsTable.hh>
+#include <G4VPhysicalVolume.hh>
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <set>
+#include <sstream>
+
+GeometryConfig::GeometryConfig()
+    : fMessenger(nullptr), fWorldMaterial("G4_AIR"),
+      fWorldSize{240. * mm, 240. * mm, 600. * mm}, fCheckOverlaps("cached"),
+      fOverlapCache("geometry_cache.txt")
+{
+  // The lab setup: two large planes, a thicker narrow one above the
+  // bottom plane and the iron plate just under the top plane
+  const G4String plastic = "G4_PLASTIC_SC_VINYLTOLUENE";
+  const G4double x = 16. * cm, y = 11. * cm, z = 2. * cm;
+  fVolumes = {{Kind::Scintillator, 0, plastic, {x, y, z}, 0.},
+              {Kind::Scintillator, 2, plastic, {x, y, z}, 10. * cm},
+              {Kind::Scintillator, 1, plastic, {x, y / 3., 2. * z}, 1.5 * z},
+              {Kind::Absorber, 0, "G4_Fe", {x, y, z}, 10. * cm - z}};
+
+  DefineCommands();
+}
+
+GeometryConfig::~GeometryConfig() { delete fMessenger; }
+
+G4int GeometryConfig::GetNumberOfChannels() const
+{
+  G4int nChannels = 0;
+  for (const auto& volume : fVolumes) {
+    if (volume.kind != Kind::Absorber) {
+      nChannels = std::max(nChannels, volume.copyNumber +
+                                          volume.planes * volume.paddles);
+    }
+  }
+  return nChannels;
+}
+
+void GeometryConfig::Load(const G4String& fileName)
+{
+  std::ifstream in(fileName);
+  if (!in) {
+    G4ExceptionDescription msg;
+    msg << "Cannot read the geometry file " << fileName
+        << ", the geometry is unchanged";
+    G4Exception("GeometryConfig::Load()", "MyCode0021", JustWarning, msg);
+    return;
+  }
+
+  G4String worldMaterial;
+  G4double worldSize[3] = {0., 0., 0.};
+  std::vector<Volume> volumes;
+  std::set<G4int> channels;
+  G4int nAbsorbers = 0;
+
+  std::string line;
+  for (G4int lineNumber = 1; std::getline(in, line); ++lineNumber) {
+    std::istringstream is(line.substr(0, line.find('#')));
+    std::string kind, unit;
+    if (!(is >> kind)) {
+      continue;
+    }
+
+    Volume volume{Kind::Absorber, 0, "", {0., 0., 0.}, 0.};
+    G4bool valid = true;
+    if (kind == "world") {
+      is >> worldMaterial >> worldSize[0] >> worldSize[1] >> worldSize[2] >>
+          unit;
+    } else if (kind == "scintillator" || kind == "array") {
+      volume.kind = kind == "array" ? Kind::Array : Kind::Scintillator;
+      is >> volume.copyNumber >> volume.material;
+      if (volume.kind == Kind::Array) {
+        is >> volume.planes >> volume.paddles;
+      }
+      is >> volume.size[0] >> volume.size[1] >> volume.size[2];
+      if (volume.kind == Kind::Array) {
+        is >> volume.pitch;
+      }
+      is >> volume.z >> unit;
+
+      // Every channel once, the planes of an array may touch
+      valid = volume.copyNumber >= 0 && volume.planes > 0 &&
+              volume.paddles > 0 &&
+              (volume.planes == 1 || volume.pitch >= volume.size[2]);
+      for (G4int i = 0; valid && i < volume.planes * volume.paddles; ++i) {
+        valid = channels.insert(volume.copyNumber + i).second;
+      }
+    } else if (kind == "absorber") {
+      volume.copyNumber = nAbsorbers++;
+      is >> volume.material >> volume.size[0] >> volume.size[1] >>
+          volume.size[2] >> volume.z >> unit;
+    } else {
+      valid = false;
+    }
+
+    std::string extra;
+    valid = valid && !is.fail() && !(is >> extra) &&
+            G4UnitDefinition::GetCategory(unit) == "Length";
+    const G4double* size = kind == "world" ? worldSize : volume.size;
+    valid = valid && size[0] > 0. && size[1] > 0. && size[2] > 0.;
+    if (!valid) {
+      G4ExceptionDescription msg;
+      msg << fileName << ":" << lineNumber << ": invalid line \"" << line
+          << "\"" << G4endl;
+      msg << "The geometry is unchanged";
+      G4Exception("GeometryConfig::Load()", "MyCode0021", JustWarning, msg);
+      return;
+    }
+
+    const G4double value = G4UnitDefinition::GetValueOf(unit);
+    if (kind == "world") {
+      for (auto& length : worldSize) {
+        length *= value;
+      }
+      continue;
+    }
+    for (auto& length : volume.size) {
+      length *= value;
+    }
+    volume.z *= value;
+    volume.pitch *= value;
+    volumes.push_back(volume);
+  }
+
+  if (worldMaterial.empty() || channels.empty()) {
+    G4ExceptionDescription msg;
+    msg << fileName << " needs a world and at least one scintillator, "
+        << "the geometry is unchanged";
+    G4Exception("GeometryConfig::Load()", "MyCode0021", JustWarning, msg);
+    return;
+  }
+
+  fWorldMaterial = worldMaterial;
+  std::copy(worldSize, worldSize + 3, fWorldSize);
+  fVolumes = volumes;
+  G4cout << "INFO: geometry of " << fileName << ", " << channels.size()
+         << " scintillator channels and " << nAbsorbers << " absorbers"
+         << G4endl;
+}
+
+G4String GeometryConfig::Describe() const
+{
+  std::ostringstream os;
+  os << std::setprecision(17);
+  os << "world " << fWorldSize[0] << ' ' << fWorldSize[1] << ' '
+     << fWorldSize[2] << '\n';
+  for (const auto& volume : fVolumes) {
+    os << static_cast<G4int>(volume.kind) << ' ' << volume.copyNumber << ' '
+       << volume.size[0] << ' ' << volume.size[1] << ' ' << volume.size[2]
+       << ' ' << volume.z << ' ' << volume.planes << ' ' << volume.paddles
+       << ' ' << volume.pitch << '\n';
+  }
+  return os.str();
+}
+
+std::uint64_t GeometryConfig::Hash(const G4String& text)
+{
+  // FNV-1a, as for the physics table cache
+  std::uint64_t hash = 0xcbf29ce484222325ULL;
+  for (const char c : text) {
+    hash ^= static_cast<unsigned char>(c);
+    hash *= 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+G4bool GeometryConfig::IsCached(std::uint64_t hash) const
+{
+  std::ifstream in(fOverlapCache);
+  std::string line;
+  while (in >> line) {
+    if (std::strtoull(line.c_str(), nullptr, 16) == hash) {
+      return true;
+    }
+  }
+  return false;
+}
+
+G4bool GeometryConfig::CheckOverlaps(
+    const std::vector<G4VPhysicalVolume*>& volumes) const
+{
+  if (fCheckOverlaps == "never") {
+    return true;
+  }
+
+  const std::uint64_t hash = Hash(Describe());
+  std::ostringstream key;
+  key << std::hex << std::setw(16) << std::setfill('0') << hash;
+  if (fCheckOverlaps == "cached" && IsCached(hash)) {
+    G4cout << "INFO: geometry " << key.str()
+           << " has no overlaps, checked by an earlier job" << G4endl;
+    return true;
+  }
+
+  G4bool overlaps = false;
+  for (auto* volume : volumes) {
+    overlaps = volume->CheckOverlaps() || overlaps;
+  }
+  if (overlaps) {
+    return false;
+  }
+
+  // Only validated geometries go to the cache
+  if (fCheckOverlaps == "cached" && !IsCached(hash)) {
+    std::ofstream out(fOverlapCache, std::ios::app);
+    out << key.str() << '\n';
+  }
+  return true;
+}
+
+void GeometryConfig::DefineCommands()
+{
+  fMessenger = new G4GenericMessenger(this, "/muon_lab/geometry/",
+                                      "Detector stack description");
+
+  auto& fileCmd = fMessenger->DeclareMethod(
+      "file", &GeometryConfig::Load, "Read the detector stack from a file");
+  fileCmd.SetParameterName("file", false);
+  fileCmd.SetStates(G4State_PreInit);
+  fileCmd.command->SetToBeBroadcasted(false);
+
+  auto& checkCmd = fMessenger->DeclareProperty(
+      "checkOverlaps", fCheckOverlaps,
+      "Overlap check of the placements: always, cached (skipped for "
+      "geometries already found without overlaps) or never");
+  checkCmd.SetParameterName("mode", false);
+  checkCmd.SetCandidates("always cached never");
+  checkCmd.SetStates(G4State_PreInit);
+  checkCmd.command->SetToBeBroadcasted(false);
+
+  auto& cacheCmd = fMessenger->DeclareProperty(
+      "overlapCache", fOverlapCache,
+      "File with the hashes of the geometries without overlaps");
+  cacheCmd.SetParameterName("file", false);
+  cacheCmd.SetStates(G4State_PreInit);
+  cacheCmd.command->SetToBeBroadcasted(false);
+}
@@ -0,0 +1,172 @@
+#include "PMTDigitizer.hh"
+#include "ScintillatorSD.hh"
+
+#include <G4DigiManager.hh>
+#include <G4Poisson.hh>
+#include <G4SDManager.hh>
+#include <G4SystemOfUnits.hh>
+#include <Randomize.hh>
+
+#include <algorithm>
+#include <cmath>
+
+void PMTDigits::Clear()
+{
+  windowStart = 0.;
+  channel.clear();
+  time.clear();
+  charge.clear();
+  peak.clear();
+  samples.clear();
+}
+
+PMTDigitizer::PMTDigitizer(const PMTResponse* response, PMTDigits* digits)
+    : G4VDigitizerModule("PMTDigitizer"), fResponse(response),
+      fScintillatorSD(nullptr), fKernelArea(0.), fNSamples(0),
+      fDigits(digits)
+{
+  G4DigiManager::GetDMpointer()->AddNewModule(this);
+}
+
+PMTDigitizer::~PMTDigitizer() {}
+
+void PMTDigitizer::BeginOfRun()
+{
+  fKernel     = fResponse->BuildKernel();
+  fKernelArea = 0.;
+  for (const auto value : fKernel) {
+    fKernelArea += value;
+  }
+  fNSamples = fResponse->GetNumberOfSamples();
+  fNoise.resize(fNSamples);
+}
+
+void PMTDigitizer::Digitize()
+{
+  fDigits->Clear();
+
+  if (!fScintillatorSD) {
+    fScintillatorSD = static_cast<ScintillatorSD*>(
+        G4SDManager::GetSDMpointer()->FindSensitiveDetector("scintillators"));
+  }
+  const auto& peChannels = fScintillatorSD->GetPhotoelectronChannels();
+  const auto& peTimes    = fScintillatorSD->GetPhotoelectronTimes();
+  if (peTimes.empty()) {
+    return;
+  }
+
+  // The window opens before the first photoelectron of the event
+  const G4double period = fResponse->GetSamplingPeriod() / ns;
+  const G4double start =
+      *std::min_element(peTimes.begin(), peTimes.end()) -
+      fResponse->GetPreTrigger() / ns;
+  fDigits->windowStart = start;
+
+  // Photoelectrons and dark counts on the sampling grid, with their gains.
+  // Only the occupied channels get a slot in the buffers, so the cost of an
+  // event does not grow with the size of the arrays
+  const G4int nChannels  = fScintillatorSD->GetNumberOfChannels();
+  const G4double spread  = fResponse->GetGainSpread();
+  const auto gain        = [spread]() {
+    return spread > 0. ? std::max(0., G4RandGauss::shoot(1., spread)) : 1.;
+  };
+  fSlot.resize(nChannels, -1);
+  fOccupied.clear();
+  fInput.clear();
+  const auto input = [this](G4int channel) {
+    if (fSlot[channel] < 0) {
+      fSlot[channel] = fOccupied.size();
+      fOccupied.push_back(channel);
+      fInput.resize(fInput.size() + fNSamples, 0.f);
+    }
+    return &fInput[fSlot[channel] * fNSamples];
+  };
+  for (std::size_t i = 0; i < peTimes.size(); ++i) {
+    const G4int bin =
+        static_cast<G4int>(std::floor((peTimes[i] - start) / period + 0.5));
+    if (bin < fNSamples) {
+      input(peChannels[i])[bin] += gain();
+    }
+  }
+  // One draw for the dark counts of all the channels, spread uniformly
+  const G4double darkCounts =
+      fResponse->GetDarkRate() * fResponse->GetWindow();
+  if (darkCounts > 0.) {
+    for (G4long n = G4Poisson(nChannels * darkCounts); n > 0; --n) {
+      const G4int channel = std::min(
+          static_cast<G4int>(G4UniformRand() * nChannels), nChannels - 1);
+      const G4int bin = static_cast<G4int>(G4UniformRand() * fNSamples);
+      input(channel)[std::min(bin, fNSamples - 1)] += gain();
+    }
+  }
+
+  // Channels without any photoelectron stay at the baseline and are not
+  // recorded, the others are recorded in channel order
+  std::sort(fOccupied.begin(), fOccupied.end());
+  const G4double noise = fResponse->GetNoise();
+  fWaveform.resize(fNSamples);
+  for (const G4int channel : fOccupied) {
+    float* waveform = fWaveform.data();
+    std::fill(fWaveform.begin(), fWaveform.end(), 0.f);
+    Convolve(&fInput[fSlot[channel] * fNSamples], waveform);
+    if (noise > 0.) {
+      G4RandGauss::shootArray(fNSamples, fNoise.data(), 0., noise);
+      for (G4int i = 0; i < fNSamples; ++i) {
+        waveform[i] += fNoise[i];
+      }
+    }
+    Discriminate(channel, waveform);
+    fSlot[channel] = -1;
+  }
+}
+
+void PMTDigitizer::Convolve(const float* input, float* output) const
+{
+  const G4int nKernel      = fKernel.size();
+  const float* __restrict h = fKernel.data();
+  for (G4int i = 0; i < fNSamples; ++i) {
+    const float amplitude = input[i];
+    if (amplitude == 0.f) {
+      continue;
+    }
+    float* __restrict y = output + i;
+    const G4int n       = std::min(nKernel, fNSamples - i);
+    for (G4int k = 0; k < n; ++k) {
+      y[k] += amplitude * h[k];
+    }
+  }
+}
+
+void PMTDigitizer::Discriminate(G4int channel, const float* samples)
+{
+  const float threshold = fResponse->GetThreshold();
+  G4int first           = -1;
+  float peak            = 0.f;
+  G4double sum          = 0.;
+  for (G4int i = 0; i < fNSamples; ++i) {
+    sum += samples[i];
+    peak = std::max(peak, samples[i]);
+    if (first < 0 && samples[i] >= threshold) {
+      first = i;
+    }
+  }
+  if (first < 0) {
+    return;
+  }
+
+  // Leading edge, interpolated between the samples around the crossing
+  G4double crossing = first;
+  if (first > 0) {
+    crossing -= (samples[first] - threshold) /
+                (samples[first] - samples[first - 1]);
+  }
+  const G4double period = fResponse->GetSamplingPeriod() / ns;
+  fDigits->channel.push_back(channel);
+  fDigits->time.push_back(fDigits->windowStart + crossing * period);
+  fDigits->charge.push_back(fKernelArea > 0. ? sum / fKernelArea : 0.);
+  fDigits->peak.push_back(peak);
+  if (fResponse->IsWaveformEnabled()) {
+    fDigits->samples.insert(fDigits->samples.end(), samples,
+                            samples + fNSamples);
+  }
+}
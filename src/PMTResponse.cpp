@@ -0,0 +1,145 @@
+#include "PMTResponse.hh"
+
+#include <G4GenericMessenger.hh>
+#include <G4SystemOfUnits.hh>
+
+#include <algorithm>
+#include <cmath>
+
+PMTResponse::PMTResponse()
+    : fMessenger(nullptr), fEnabled(false), fWaveforms(false),
+      fKeepHits(false), fSamplingPeriod(1. * ns), fWindow(500. * ns),
+      fPreTrigger(20. * ns), fRiseTime(2. * ns), fFallTime(10. * ns),
+      fGainSpread(0.3), fNoise(0.05), fDarkRate(0.), fThreshold(0.5)
+{
+  DefineCommands();
+}
+
+PMTResponse::~PMTResponse() { delete fMessenger; }
+
+G4int PMTResponse::GetNumberOfSamples() const
+{
+  return std::max(1, static_cast<G4int>(std::ceil(fWindow / fSamplingPeriod)));
+}
+
+std::vector<float> PMTResponse::BuildKernel() const
+{
+  // exp(-t/fall) - exp(-t/rise) peaks at tPeak, equal times are avoided
+  const G4double fall = fFallTime;
+  const G4double rise = std::min(fRiseTime, 0.999 * fall);
+  const auto pulse    = [rise, fall](G4double t) {
+    return rise > 0. ? std::exp(-t / fall) - std::exp(-t / rise)
+                     : std::exp(-t / fall);
+  };
+  const G4double tPeak =
+      rise > 0. ? rise * fall / (fall - rise) * std::log(fall / rise) : 0.;
+  const G4double peak = pulse(tPeak);
+
+  // Sample k is k periods after the photoelectron, cut at 1e-3 of the peak
+  std::vector<float> kernel;
+  const G4int maxSamples = GetNumberOfSamples();
+  for (G4int k = 0; k < maxSamples; ++k) {
+    const G4double t     = k * fSamplingPeriod;
+    const G4double value = pulse(t) / peak;
+    if (t > tPeak && value < 1.e-3) {
+      break;
+    }
+    kernel.push_back(value);
+  }
+  return kernel;
+}
+
+void PMTResponse::DefineCommands()
+{
+  fMessenger = new G4GenericMessenger(this, "/muon_lab/digi/",
+                                      "PMT digitization of the scintillators");
+
+  // The workers read this object directly, nothing to broadcast
+  auto& enableCmd = fMessenger->DeclareProperty(
+      "enable", fEnabled,
+      "Digitize the photoelectrons of the fast optical model");
+  enableCmd.SetParameterName("flag", false);
+  enableCmd.SetStates(G4State_PreInit, G4State_Idle);
+  enableCmd.command->SetToBeBroadcasted(false);
+
+  auto& waveformCmd = fMessenger->DeclareProperty(
+      "waveforms", fWaveforms,
+      "Also write the samples of the channels that fired");
+  waveformCmd.SetParameterName("flag", false);
+  waveformCmd.SetStates(G4State_PreInit, G4State_Idle);
+  waveformCmd.command->SetToBeBroadcasted(false);
+
+  auto& keepHitsCmd = fMessenger->DeclareProperty(
+      "keepHits", fKeepHits,
+      "Also write the hits to the ntuple and the columnar files");
+  keepHitsCmd.SetParameterName("flag", false);
+  keepHitsCmd.SetStates(G4State_PreInit, G4State_Idle);
+  keepHitsCmd.command->SetToBeBroadcasted(false);
+
+  auto& periodCmd = fMessenger->DeclarePropertyWithUnit(
+      "samplingPeriod", "ns", fSamplingPeriod, "Digitizer sampling period");
+  periodCmd.SetParameterName("period", false);
+  periodCmd.SetRange("period>0.");
+  periodCmd.SetStates(G4State_PreInit, G4State_Idle);
+  periodCmd.command->SetToBeBroadcasted(false);
+
+  auto& windowCmd = fMessenger->DeclarePropertyWithUnit(
+      "window", "ns", fWindow, "Length of the digitized window");
+  windowCmd.SetParameterName("window", false);
+  windowCmd.SetRange("window>0.");
+  windowCmd.SetStates(G4State_PreInit, G4State_Idle);
+  windowCmd.command->SetToBeBroadcasted(false);
+
+  auto& preCmd = fMessenger->DeclarePropertyWithUnit(
+      "preTrigger", "ns", fPreTrigger,
+      "Start of the window before the first photoelectron of the event");
+  preCmd.SetParameterName("pre", false);
+  preCmd.SetRange("pre>=0.");
+  preCmd.SetStates(G4State_PreInit, G4State_Idle);
+  preCmd.command->SetToBeBroadcasted(false);
+
+  auto& riseCmd = fMessenger->DeclarePropertyWithUnit(
+      "riseTime", "ns", fRiseTime, "Rise time constant of the PMT pulse");
+  riseCmd.SetParameterName("rise", false);
+  riseCmd.SetRange("rise>=0.");
+  riseCmd.SetStates(G4State_PreInit, G4State_Idle);
+  riseCmd.command->SetToBeBroadcasted(false);
+
+  auto& fallCmd = fMessenger->DeclarePropertyWithUnit(
+      "fallTime", "ns", fFallTime, "Fall time constant of the PMT pulse");
+  fallCmd.SetParameterName("fall", false);
+  fallCmd.SetRange("fall>0.");
+  fallCmd.SetStates(G4State_PreInit, G4State_Idle);
+  fallCmd.command->SetToBeBroadcasted(false);
+
+  auto& gainCmd = fMessenger->DeclareProperty(
+      "gainSpread", fGainSpread,
+      "Relative sigma of the single photoelectron gain");
+  gainCmd.SetParameterName("sigma", false);
+  gainCmd.SetRange("sigma>=0.");
+  gainCmd.SetStates(G4State_PreInit, G4State_Idle);
+  gainCmd.command->SetToBeBroadcasted(false);
+
+  auto& noiseCmd = fMessenger->DeclareProperty(
+      "noise", fNoise,
+      "Sigma of the electronic noise of a sample, in photoelectron peaks");
+  noiseCmd.SetParameterName("sigma", false);
+  noiseCmd.SetRange("sigma>=0.");
+  noiseCmd.SetStates(G4State_PreInit, G4State_Idle);
+  noiseCmd.command->SetToBeBroadcasted(false);
+
+  auto& darkCmd = fMessenger->DeclarePropertyWithUnit(
+      "darkRate", "Hz", fDarkRate, "Dark count rate of every channel");
+  darkCmd.SetParameterName("rate", false);
+  darkCmd.SetRange("rate>=0.");
+  darkCmd.SetStates(G4State_PreInit, G4State_Idle);
+  darkCmd.command->SetToBeBroadcasted(false);
+
+  auto& thresholdCmd = fMessenger->DeclareProperty(
+      "threshold", fThreshold,
+      "Discriminator threshold, in photoelectron peaks");
+  thresholdCmd.SetParameterName("threshold", false);
+  thresholdCmd.SetRange("threshold>0.");
+  thresholdCmd.SetStates(G4State_PreInit, G4State_Idle);
+  thresholdCmd.command->SetToBeBroadcasted(false);
+}
@@ -0,0 +1,141 @@
+#include "PhysicsList.hh"
+
+#include <G4DecayPhysics.hh>
+#include <G4EmExtraPhysics.hh>
+#include <G4EmStandardPhysics.hh>
+#include <G4EmStandardPhysics_option1.hh>
+#include <G4EmStandardPhysics_option4.hh>
+#include <G4Exception.hh>
+#include <G4GenericBiasingPhysics.hh>
+#include <G4GenericMessenger.hh>
+#include <G4HadronElasticPhysics.hh>
+#include <G4HadronPhysicsQGSP_BERT.hh>
+#include <G4IonPhysics.hh>
+#include <G4NeutronTrackingCut.hh>
+#include <G4OpticalPhysics.hh>
+#include <G4StepLimiterPhysics.hh>
+#include <G4StoppingPhysics.hh>
+#include <G4SystemOfUnits.hh>
+#include <G4VPhysicsConstructor.hh>
+
+PhysicsList::PhysicsList()
+    : G4VModularPhysicsList(), fMessenger(nullptr), fProfile(),
+      fParticleList(new G4DecayPhysics())
+{
+  // Cut of the world air, the detector regions have their own cuts
+  SetDefaultCutValue(1. * cm);
+
+  SetProfile("full-optical");
+  DefineCommands();
+}
+
+PhysicsList::~PhysicsList()
+{
+  delete fMessenger;
+  ClearConstructors();
+  delete fParticleList;
+}
+
+void PhysicsList::ConstructParticle()
+{
+  // Called once on the master, after main set the verbosity
+  fParticleList->SetVerboseLevel(GetVerboseLevel());
+  for (auto* constructor : fConstructors) {
+    constructor->SetVerboseLevel(GetVerboseLevel());
+  }
+  fParticleList->ConstructParticle();
+}
+
+void PhysicsList::ConstructProcess()
+{
+  AddTransportation();
+  fParticleList->ConstructProcess();
+  for (auto* constructor : fConstructors) {
+    constructor->ConstructProcess();
+  }
+}
+
+void PhysicsList::ClearConstructors()
+{
+  for (auto* constructor : fConstructors) {
+    delete constructor;
+  }
+  fConstructors.clear();
+}
+
+void PhysicsList::SetProfile(const G4String& profile)
+{
+  if (profile == fProfile) {
+    return;
+  }
+
+  // The hadronic part of QGSP_BERT, without its EM constructor
+  const auto addQGSP_BERT = [this]() {
+    fConstructors.push_back(new G4EmExtraPhysics());
+    fConstructors.push_back(new G4HadronElasticPhysics());
+    fConstructors.push_back(new G4HadronPhysicsQGSP_BERT());
+    fConstructors.push_back(new G4StoppingPhysics());
+    fConstructors.push_back(new G4IonPhysics());
+    fConstructors.push_back(new G4NeutronTrackingCut());
+  };
+
+  if (profile == "full-optical") {
+    ClearConstructors();
+    fConstructors.push_back(new G4EmStandardPhysics_option4());
+    addQGSP_BERT();
+
+    auto* opticalPhysics = new G4OpticalPhysics();
+    opticalPhysics->Configure(kCerenkov, false);
+    opticalPhysics->SetCerenkovStackPhotons(true);
+    opticalPhysics->Configure(kScintillation, true);
+    fConstructors.push_back(opticalPhysics);
+  } else if (profile == "calorimetric") {
+    ClearConstructors();
+    fConstructors.push_back(new G4EmStandardPhysics_option1());
+    addQGSP_BERT();
+  } else if (profile == "fast-muon") {
+    // Muon nuclear interactions and mu- capture at rest are the only
+    // hadronic processes a muon needs
+    ClearConstructors();
+    fConstructors.push_back(new G4EmStandardPhysics());
+    fConstructors.push_back(new G4EmExtraPhysics());
+    fConstructors.push_back(new G4StoppingPhysics());
+  } else {
+    G4ExceptionDescription msg;
+    msg << "Unknown physics profile " << profile << ", keeping "
+        << fProfile << G4endl;
+    msg << "Available: full-optical, calorimetric, fast-muon";
+    G4Exception("PhysicsList::SetProfile()", "MyCode0011", JustWarning, msg);
+    return;
+  }
+
+  // Applies the /muon_lab/limits/ user limits of the regions
+  fConstructors.push_back(new G4StepLimiterPhysics());
+
+  // Wraps the muon decay for the /muon_lab/bias/ operators, analog in
+  // the volumes without one
+  auto* biasingPhysics = new G4GenericBiasingPhysics();
+  biasingPhysics->PhysicsBias("mu-", {"Decay"});
+  biasingPhysics->PhysicsBias("mu+", {"Decay"});
+  fConstructors.push_back(biasingPhysics);
+
+  fProfile = profile;
+  for (auto* constructor : fConstructors) {
+    constructor->SetVerboseLevel(GetVerboseLevel());
+  }
+}
+
+void PhysicsList::DefineCommands()
+{
+  fMessenger = new G4GenericMessenger(this, "/muon_lab/physics/",
+                                      "Physics configuration");
+
+  // The constructors are only chosen on the master
+  auto& profileCmd = fMessenger->DeclareMethod(
+      "profile", &PhysicsList::SetProfile,
+      "Physics profile: full-optical, calorimetric or fast-muon");
+  profileCmd.SetParameterName("profile", false);
+  profileCmd.SetCandidates("full-optical calorimetric fast-muon");
+  profileCmd.SetStates(G4State_PreInit);
+  profileCmd.command->SetToBeBroadcasted(false);
+}
@@ -0,0 +1,185 @@
+#include "PhysicsTableCache.hh"
+#include "PhysicsList.hh"
+
+#include <G4Element.hh>
+#include <G4EmParameters.hh>
+#include <G4Exception.hh>
+#include <G4GenericMessenger.hh>
+#include <G4Material.hh>
+#include <G4ProductionCuts.hh>
+#include <G4ProductionCutsTable.hh>
+#include <G4Region.hh>
+#include <G4RegionStore.hh>
+#include <G4StateManager.hh>
+#include <G4VPhysicsConstructor.hh>
+#include <G4Version.hh>
+
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+// Written last, a cache directory without it is incomplete
+const char* const kDescriptionFile = "description.txt";
+} // namespace
+
+PhysicsTableCache::PhysicsTableCache(PhysicsList* physicsList)
+    : G4VStateDependent(), fPhysicsList(physicsList), fMessenger(nullptr),
+      fEnabled(true), fBaseDirectory("physics_cache"), fStorePending(false),
+      fDone(false)
+{
+  DefineCommands();
+}
+
+PhysicsTableCache::~PhysicsTableCache() { delete fMessenger; }
+
+G4bool PhysicsTableCache::Notify(G4ApplicationState requestedState)
+{
+  const auto state = G4StateManager::GetStateManager()->GetCurrentState();
+
+  // Idle -> Init starts the run initialization, before the tables are built
+  if (state == G4State_Idle && requestedState == G4State_Init && !fDone) {
+    fDone = true;
+    if (fEnabled) {
+      PrepareRetrieval();
+    }
+  }
+
+  // Init -> Idle ends it, the master tables are ready
+  if (state == G4State_Init && requestedState == G4State_Idle && fDone) {
+    if (fStorePending) {
+      fStorePending = false;
+      Store();
+    }
+    // The workers build from the master tables, not from the files
+    fPhysicsList->ResetPhysicsTableRetrieved();
+  }
+  return true;
+}
+
+std::uint64_t PhysicsTableCache::Hash(const G4String& text)
+{
+  // FNV-1a
+  std::uint64_t hash = 0xcbf29ce484222325ULL;
+  for (const char c : text) {
+    hash ^= static_cast<unsigned char>(c);
+    hash *= 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+G4String PhysicsTableCache::Describe() const
+{
+  std::ostringstream os;
+  os << std::setprecision(17);
+  os << G4Version << '\n';
+
+  os << "profile " << fPhysicsList->GetProfile() << '\n';
+  for (const auto* constructor : fPhysicsList->GetConstructors()) {
+    os << "physics " << constructor->GetPhysicsName() << ' '
+       << constructor->GetPhysicsType() << '\n';
+  }
+  os << *G4EmParameters::Instance();
+
+  const auto* cutsTable = G4ProductionCutsTable::GetProductionCutsTable();
+  os << "energyRange " << cutsTable->GetLowEdgeEnergy() << ' '
+     << cutsTable->GetHighEdgeEnergy() << '\n';
+
+  for (const auto* material : *G4Material::GetMaterialTable()) {
+    os << "material " << material->GetName() << ' ' << material->GetDensity()
+       << ' ' << material->GetIonisation()->GetMeanExcitationEnergy();
+    const auto* fractions = material->GetFractionVector();
+    for (std::size_t i = 0; i < material->GetNumberOfElements(); ++i) {
+      os << ' ' << material->GetElement(i)->GetZ() << ':' << fractions[i];
+    }
+    os << '\n';
+  }
+
+  for (const auto* region : *G4RegionStore::GetInstance()) {
+    os << "region " << region->GetName();
+    if (const auto* cuts = region->GetProductionCuts()) {
+      for (const auto cut : cuts->GetProductionCuts()) {
+        os << ' ' << cut;
+      }
+    }
+    os << '\n';
+  }
+  return os.str();
+}
+
+void PhysicsTableCache::PrepareRetrieval()
+{
+  fDescription = Describe();
+
+  std::ostringstream name;
+  name << std::hex << std::setw(16) << std::setfill('0') << Hash(fDescription);
+  fDirectory = (fs::path(fBaseDirectory) / name.str()).string();
+
+  // Only a complete cache of exactly this configuration is used
+  std::ifstream in(fs::path(fDirectory) / kDescriptionFile);
+  std::stringstream stored;
+  stored << in.rdbuf();
+  if (in && stored.str() == fDescription) {
+    G4cout << "INFO: retrieving physics tables from " << fDirectory << G4endl;
+    fPhysicsList->SetPhysicsTableRetrieved(fDirectory);
+    return;
+  }
+
+  fStorePending = true;
+}
+
+void PhysicsTableCache::Store()
+{
+  // Written to a private directory and renamed, so concurrent jobs never
+  // see a partial cache
+  const fs::path target(fDirectory);
+  const fs::path staging =
+      target.string() + ".tmp" + std::to_string(::getpid());
+
+  std::error_code ec;
+  fs::create_directories(staging, ec);
+  G4bool stored =
+      !ec && fPhysicsList->StorePhysicsTable(G4String(staging.string()));
+  if (stored) {
+    std::ofstream out(staging / kDescriptionFile);
+    out << fDescription;
+    stored = static_cast<bool>(out);
+  }
+  if (stored) {
+    fs::rename(staging, target, ec);
+    if (!ec) {
+      G4cout << "INFO: physics tables stored in " << fDirectory << G4endl;
+    }
+  } else {
+    G4ExceptionDescription msg;
+    msg << "Could not store the physics tables in " << staging.string();
+    G4Exception("PhysicsTableCache::Store()", "MyCode0010", JustWarning, msg);
+  }
+
+  // Another job stored the same tables first, or the store failed
+  fs::remove_all(staging, ec);
+}
+
+void PhysicsTableCache::DefineCommands()
+{
+  fMessenger = new G4GenericMessenger(this, "/muon_lab/physics/cache/",
+                                      "Physics table cache");
+
+  // Used by the master only, nothing to broadcast
+  auto& cacheCmd = fMessenger->DeclareProperty(
+      "enable", fEnabled, "Store and retrieve the physics tables");
+  cacheCmd.SetParameterName("flag", false);
+  cacheCmd.SetStates(G4State_PreInit, G4State_Idle);
+  cacheCmd.command->SetToBeBroadcasted(false);
+
+  auto& dirCmd = fMessenger->DeclareProperty(
+      "directory", fBaseDirectory,
+      "Directory of the physics table cache");
+  dirCmd.SetParameterName("dir", false);
+  dirCmd.SetStates(G4State_PreInit, G4State_Idle);
+  dirCmd.command->SetToBeBroadcasted(false);
+}
@@ -1,16 +1,42 @@
 #include "PrimaryGeneratorAction.hh"
 
 #include <G4Box.hh>
+#include <G4EmCalculator.hh>
+#include <G4Event.hh>
 #include <G4Exception.hh>
 #include <G4GeneralParticleSource.hh>
+#include <G4GenericMessenger.hh>
+#include <G4IonTable.hh>
 #include <G4LogicalVolumeStore.hh>
+#include <G4MuonMinus.hh>
+#include <G4MuonPlus.hh>
 #include <G4ParticleDefinition.hh>
+#include <G4ParticleGun.hh>
 #include <G4ParticleTable.hh>
+#include <G4PhysicalConstants.hh>
+#include <G4PrimaryVertex.hh>
+#include <G4Run.hh>
+#include <G4RunManager.hh>
 #include <G4SystemOfUnits.hh>
+#include <G4VPVParameterisation.hh>
+#include <G4VPhysicalVolume.hh>
+#include <G4VSolid.hh>
 #include <G4ios.hh>
+#include <Randomize.hh>
 
-PrimaryGeneratorAction::PrimaryGeneratorAction()
-    : G4VUserPrimaryGeneratorAction(), fParticleGun(nullptr)
+#include <algorithm>
+#include <map>
+
+PrimaryGeneratorAction::PrimaryGeneratorAction(const EventSeeder* eventSeeder,
+                                               const PrimaryLibrary* library)
+    : G4VUserPrimaryGeneratorAction(), fEventSeeder(eventSeeder),
+      fLibrary(library), fParticleGun(nullptr),
+      fCosmicGun(nullptr), fMessenger(nullptr), fMode(Mode::GPS),
+      fCosmicEmin(10. * MeV), fCosmicEmax(1. * TeV), fCosmicCosThetaMin(0.),
+      fChargeRatio(1.2766), fEnergyBins(256), fAngleBins(128), fStopBias(1.),
+      fWorldHalfX(0.), fWorldHalfY(0.), fWorldHalfZ(0.), fAcceptanceFlux(1.),
+      fSlopeLo{0., 0.}, fSlopeHi{0., 0.}, fMuonPlus(G4MuonPlus::Definition()),
+      fMuonMinus(G4MuonMinus::Definition()), fReplayed(nullptr)
 {
   G4int nParticles = 1;
   fParticleGun     = new G4GeneralParticleSource();
@@ -21,20 +47,28 @@ PrimaryGeneratorAction::PrimaryGeneratorAction()
       G4ParticleTable::GetParticleTable()->FindParticle(particleName = "mu-");
   fParticleGun->SetParticleDefinition(particleDefinition);
   fParticleGun->SetNumberOfParticles(nParticles);
-  // TODO(#4): Energy should come from the energy distribution of cosmic ray muons
-}
 
-PrimaryGeneratorAction::~PrimaryGeneratorAction() { delete fParticleGun; }
+  // Lightweight gun for the cosmic and library modes, the kinematics are
+  // set per event
+  fCosmicGun = new G4ParticleGun(nParticles);
+  fCosmicGun->SetParticleDefinition(fMuonMinus);
 
-void PrimaryGeneratorAction::GeneratePrimaries(G4Event* anEvent)
+  DefineCommands();
+}
+
+PrimaryGeneratorAction::~PrimaryGeneratorAction()
 {
-  // this function is called at the begining of each event
+  delete fMessenger;
+  delete fCosmicGun;
+  delete fParticleGun;
+}
 
+void PrimaryGeneratorAction::BeginOfRun()
+{
   // In order to avoid dependence of PrimaryGeneratorAction
   // on DetectorConstruction class we get Envelope volume
   // from G4LogicalVolumeStore.
-
-  G4double worldZHalfLenght = 0.0;
+  fWorldHalfX = fWorldHalfY = fWorldHalfZ = 0.;
   auto* worldLV = G4LogicalVolumeStore::GetInstance()->GetVolume("World");
 
   // Check th world volume shape
@@ -44,19 +78,576 @@ void PrimaryGeneratorAction::GeneratePrimaries(G4Event* anEvent)
   }
 
   if (worldBox) {
-    worldZHalfLenght = worldBox->GetZHalfLength();
+    fWorldHalfX = worldBox->GetXHalfLength();
+    fWorldHalfY = worldBox->GetYHalfLength();
+    fWorldHalfZ = worldBox->GetZHalfLength();
   } else {
     G4ExceptionDescription msg;
     msg << "World volume is not a box shape" << G4endl;
     msg << "Geometry has changed" << G4endl;
     msg << "The gun will be placed in the center";
-    G4Exception("PrimaryGeneratorAction::GeneratePrimaries()", "MyCode0002",
+    G4Exception("PrimaryGeneratorAction::BeginOfRun()", "MyCode0002",
                 JustWarning, msg);
   }
 
+  // Nothing is generated, the records are replayed as they are
+  if (fMode == Mode::Library && !fLibrary->IsReadable()) {
+    G4ExceptionDescription msg;
+    msg << "No primary library to replay, see /muon_lab/library/read";
+    G4Exception("PrimaryGeneratorAction::BeginOfRun()", "MyCode0023",
+                FatalException, msg);
+  }
+  if (fMode == Mode::GPS || fMode == Mode::Library) {
+    return;
+  }
+
+  CosmicMuonSpectrum::Importance importance = nullptr;
+  if (fStopBias != 1.) {
+    FindLayers();
+    importance = StopImportance();
+  }
+
+  const G4double mass = fMuonMinus->GetPDGMass();
+  if (fMode == Mode::Cosmic) {
+    fSpectrum.Build(fCosmicEmin, fCosmicEmax, fCosmicCosThetaMin, 1., mass,
+                    fEnergyBins, fAngleBins, importance);
+  } else if (fMode == Mode::Acceptance) {
+    FindScintillatorStack();
+
+    // Only the zenith angles whose circle of slopes meets the accepted
+    // slopes are tabulated, the flux outside them can never give a
+    // coincidence and every direction drawn can cross the stack
+    G4double cosMin = fCosmicCosThetaMin;
+    G4double cosMax = 1.;
+    if (FindAcceptedSlopes()) {
+      G4double nearest[2], farthest[2];
+      for (G4int k = 0; k < 2; ++k) {
+        nearest[k]  = std::max({fSlopeLo[k], -fSlopeHi[k], 0.});
+        farthest[k] = std::max(std::abs(fSlopeLo[k]), std::abs(fSlopeHi[k]));
+      }
+      const G4double tanMin = std::hypot(nearest[0], nearest[1]);
+      const G4double tanMax = std::hypot(farthest[0], farthest[1]);
+      cosMin = std::max(cosMin, 1. / std::sqrt(1. + tanMax * tanMax));
+      cosMax = 1. / std::sqrt(1. + tanMin * tanMin);
+    }
+    CosmicMuonSpectrum full;
+    full.Build(fCosmicEmin, fCosmicEmax, fCosmicCosThetaMin, 1., mass,
+               fEnergyBins, fAngleBins);
+    fSpectrum.Build(fCosmicEmin, fCosmicEmax, cosMin, cosMax, mass,
+                    fEnergyBins, fAngleBins, importance);
+    fAcceptanceFlux = fSpectrum.GetIntegral() / full.GetIntegral();
+
+    G4cout << "INFO: acceptance mode, " << fStack.size()
+           << " scintillator planes, " << cosMin << " < cos(theta) < "
+           << cosMax << ", flux fraction " << fAcceptanceFlux << G4endl;
+  }
+
+  if (importance) {
+    G4cout << "INFO: stopping bias " << fStopBias << ", "
+           << 100. * fSpectrum.GetBiasedFraction()
+           << " % of the muons drawn below the stopping energy, "
+           << StoppingEnergy(1.) / MeV << " MeV at normal incidence"
+           << G4endl;
+  }
+}
+
+PrimaryGeneratorAction::Bounds
+PrimaryGeneratorAction::WorldBounds(const G4VPhysicalVolume* volume)
+{
+  G4ThreeVector pMin, pMax;
+  volume->GetLogicalVolume()->GetSolid()->BoundingLimits(pMin, pMax);
+  return MotherBounds({{pMin.x(), pMin.y(), pMin.z()},
+                       {pMax.x(), pMax.y(), pMax.z()}},
+                      volume);
+}
+
+PrimaryGeneratorAction::Bounds
+PrimaryGeneratorAction::MotherBounds(const Bounds& local,
+                                     const G4VPhysicalVolume* volume)
+{
+  const auto rotation    = volume->GetObjectRotationValue();
+  const auto translation = volume->GetObjectTranslation();
+
+  Bounds bounds = {{kInfinity, kInfinity, kInfinity},
+                   {-kInfinity, -kInfinity, -kInfinity}};
+  for (G4int c = 0; c < 8; ++c) {
+    G4ThreeVector corner((c & 1) ? local.hi[0] : local.lo[0],
+                         (c & 2) ? local.hi[1] : local.lo[1],
+                         (c & 4) ? local.hi[2] : local.lo[2]);
+    corner = rotation * corner + translation;
+    for (G4int k = 0; k < 3; ++k) {
+      bounds.lo[k] = std::min(bounds.lo[k], corner[k]);
+      bounds.hi[k] = std::max(bounds.hi[k], corner[k]);
+    }
+  }
+  return bounds;
+}
+
+void PrimaryGeneratorAction::FindScintillatorStack()
+{
+  fStack.clear();
+  auto* worldLV = G4LogicalVolumeStore::GetInstance()->GetVolume("World");
+  if (!worldLV) {
+    return;
+  }
+
+  // Every scintillator plane is a direct daughter of the world whose
+  // logical volume name starts with "scint"
+  for (G4int i = 0; i < worldLV->GetNoDaughters(); ++i) {
+    auto* daughter = worldLV->GetDaughter(i);
+    auto* lv       = daughter->GetLogicalVolume();
+    if (lv->GetName().compare(0, 5, "scint") != 0) {
+      continue;
+    }
+
+    fStack.push_back(WorldBounds(daughter));
+  }
+
+  if (fStack.empty()) {
+    G4ExceptionDescription msg;
+    msg << "No scintillator volume found in the world" << G4endl;
+    msg << "The acceptance mode falls back to the full cosmic flux";
+    G4Exception("PrimaryGeneratorAction::FindScintillatorStack()",
+                "MyCode0005", JustWarning, msg);
+  }
+}
+
+void PrimaryGeneratorAction::FindLayers()
+{
+  fLayers.clear();
+  auto* worldLV = G4LogicalVolumeStore::GetInstance()->GetVolume("World");
+  if (!worldLV) {
+    return;
+  }
+
+  // The daughters of the world, sorted from the top down. Where they
+  // overlap in z the upper one wins, the gaps are filled with world air.
+  std::vector<std::pair<Bounds, const G4Material*>> slabs;
+  for (G4int i = 0; i < worldLV->GetNoDaughters(); ++i) {
+    auto* daughter = worldLV->GetDaughter(i);
+    auto* lv       = daughter->GetLogicalVolume();
+
+    // An array is seen through its parameterised planes, filled by their
+    // paddles, and its box of world air like the gaps. The transformation
+    // of the planes is thread local, the navigator sets it again.
+    if (lv->GetNoDaughters() == 1 && lv->GetDaughter(0)->IsParameterised()) {
+      auto* plane            = lv->GetDaughter(0);
+      auto* parameterisation = plane->GetParameterisation();
+      for (G4int copy = 0; copy < plane->GetMultiplicity(); ++copy) {
+        parameterisation->ComputeTransformation(copy, plane);
+        slabs.emplace_back(MotherBounds(WorldBounds(plane), daughter),
+                           parameterisation->ComputeMaterial(copy, plane));
+      }
+      continue;
+    }
+    slabs.emplace_back(WorldBounds(daughter), lv->GetMaterial());
+  }
+  std::sort(slabs.begin(), slabs.end(), [](const auto& a, const auto& b) {
+    return a.first.hi[2] > b.first.hi[2];
+  });
+
+  G4double z = fWorldHalfZ;
+  for (const auto& slab : slabs) {
+    const G4double top    = std::min(z, slab.first.hi[2]);
+    const G4double bottom = slab.first.lo[2];
+    if (top <= bottom) {
+      continue;
+    }
+    if (z > top) {
+      fLayers.push_back({z - top, worldLV->GetMaterial()});
+    }
+    fLayers.push_back({top - bottom, slab.second});
+    z = bottom;
+  }
+  std::reverse(fLayers.begin(), fLayers.end());
+}
+
+G4double PrimaryGeneratorAction::StoppingEnergy(G4double cosTheta) const
+{
+  // Walk up from the bottom of the stack: at the top of each layer the
+  // muon needs the energy whose range is the layer plus what it needs below
+  G4EmCalculator calculator;
+  const G4double secTheta = 1. / std::max(cosTheta, 1.e-3);
+  G4double ekin           = 0.;
+  for (const auto& layer : fLayers) {
+    const G4double range =
+        ekin > 0. ? calculator.GetRangeFromRestricteDEDX(ekin, fMuonMinus,
+                                                         layer.material)
+                  : 0.;
+    ekin = calculator.GetKinEnergy(range + layer.thickness * secTheta,
+                                   fMuonMinus, layer.material);
+  }
+  return ekin;
+}
+
+CosmicMuonSpectrum::Importance PrimaryGeneratorAction::StopImportance() const
+{
+  // The spectrum asks for the same cos(theta) at every energy, the
+  // stopping energy of each is only computed once
+  std::map<G4double, G4double> stoppingEnergy;
+  const G4double bias = fStopBias;
+  return [this, stoppingEnergy, bias](G4double ekin,
+                                      G4double cosTheta) mutable {
+    auto it = stoppingEnergy.find(cosTheta);
+    if (it == stoppingEnergy.end()) {
+      it = stoppingEnergy.emplace(cosTheta, StoppingEnergy(cosTheta)).first;
+    }
+    return ekin < it->second ? bias : 1.;
+  };
+}
+
+G4double PrimaryGeneratorAction::AcceptanceCosTheta() const
+{
+  // A straight line crossing two planes separated by dz cannot be more
+  // inclined than the largest lateral distance between them allows
+  G4double tanMax = kInfinity;
+  for (std::size_t a = 0; a < fStack.size(); ++a) {
+    for (std::size_t b = a + 1; b < fStack.size(); ++b) {
+      const auto& p = fStack[a];
+      const auto& q = fStack[b];
+      const G4double dz = std::max(p.lo[2] - q.hi[2], q.lo[2] - p.hi[2]);
+      if (dz <= 0.) {
+        continue;
+      }
+      const G4double dx = std::max(p.hi[0] - q.lo[0], q.hi[0] - p.lo[0]);
+      const G4double dy = std::max(p.hi[1] - q.lo[1], q.hi[1] - p.lo[1]);
+      tanMax = std::min(tanMax, std::sqrt(dx * dx + dy * dy) / dz);
+    }
+  }
+
+  if (tanMax == kInfinity) {
+    return 0.;
+  }
+  return 1. / std::sqrt(1. + tanMax * tanMax);
+}
+
+void PrimaryGeneratorAction::StackShadow(G4double tx, G4double ty,
+                                         G4double& xlo, G4double& xhi,
+                                         G4double& ylo, G4double& yhi) const
+{
+  // Shadow of every plane on the generation plane along the direction,
+  // by default the whole world footprint
+  const G4double zPlane = fWorldHalfZ - 1. * um;
+  xlo = -fWorldHalfX, xhi = fWorldHalfX;
+  ylo = -fWorldHalfY, yhi = fWorldHalfY;
+  for (const auto& b : fStack) {
+    const G4double dropTop    = zPlane - b.hi[2];
+    const G4double dropBottom = zPlane - b.lo[2];
+    xlo = std::max(xlo, b.lo[0] - std::max(dropTop * tx, dropBottom * tx));
+    xhi = std::min(xhi, b.hi[0] - std::min(dropTop * tx, dropBottom * tx));
+    ylo = std::max(ylo, b.lo[1] - std::max(dropTop * ty, dropBottom * ty));
+    yhi = std::min(yhi, b.hi[1] - std::min(dropTop * ty, dropBottom * ty));
+  }
+}
+
+G4bool PrimaryGeneratorAction::FindAcceptedSlopes()
+{
+  if (fStack.empty()) {
+    return false;
+  }
+
+  // No crossing line is steeper than the cone of the stack
+  const G4double cosCone =
+      std::max({AcceptanceCosTheta(), fCosmicCosThetaMin, 1e-3});
+  const G4double tanCone = std::sqrt(1. - cosCone * cosCone) / cosCone;
+
+  // The origins along x only depend on the slope along x, and likewise
+  // for y. The lines crossing every box are a convex set, so the slopes
+  // with an origin form an interval: scan for it, then bisect its ends.
+  const G4int nSteps = 4096;
+  for (G4int k = 0; k < 2; ++k) {
+    const auto accepted = [this, k](G4double t) {
+      G4double xlo, xhi, ylo, yhi;
+      StackShadow(k == 0 ? t : 0., k == 1 ? t : 0., xlo, xhi, ylo, yhi);
+      return k == 0 ? xlo < xhi : ylo < yhi;
+    };
+    const auto slope = [tanCone](G4int i) {
+      return tanCone * (2. * i / nSteps - 1.);
+    };
+
+    G4int first = -1, last = -1;
+    for (G4int i = 0; i <= nSteps; ++i) {
+      if (accepted(slope(i))) {
+        first = first < 0 ? i : first;
+        last  = i;
+      }
+    }
+    if (first < 0) {
+      G4ExceptionDescription msg;
+      msg << "No straight line crosses the whole scintillator stack" << G4endl;
+      msg << "The acceptance mode falls back to the full cosmic flux";
+      G4Exception("PrimaryGeneratorAction::FindAcceptedSlopes()",
+                  "MyCode0005", JustWarning, msg);
+      fStack.clear();
+      return false;
+    }
+
+    const auto edge = [&accepted](G4double in, G4double out) {
+      for (G4int i = 0; i < 60; ++i) {
+        const G4double middle = 0.5 * (in + out);
+        (accepted(middle) ? in : out) = middle;
+      }
+      return in;
+    };
+    fSlopeLo[k] = first > 0 ? edge(slope(first), slope(first - 1))
+                            : slope(first);
+    fSlopeHi[k] = last < nSteps ? edge(slope(last), slope(last + 1))
+                                : slope(last);
+  }
+  return true;
+}
+
+G4double PrimaryGeneratorAction::SampleAcceptedPhi(G4double slope,
+                                                   G4double& phi) const
+{
+  if (slope <= 0.) {
+    phi = twopi * G4UniformRand();
+    return 1.;
+  }
+
+  // The circle of slopes (slope cos phi, slope sin phi) crosses the sides
+  // of the accepted rectangle at most 8 times, the arcs between the
+  // crossings are either inside or outside
+  G4double cuts[10];
+  G4int nCuts     = 0;
+  cuts[nCuts++]   = 0.;
+  cuts[nCuts++]   = twopi;
+  for (G4int k = 0; k < 2; ++k) {
+    for (const G4double side : {fSlopeLo[k], fSlopeHi[k]}) {
+      if (std::abs(side) >= slope) {
+        continue;
+      }
+      if (k == 0) {
+        const G4double angle = std::acos(side / slope);
+        cuts[nCuts++]        = angle;
+        cuts[nCuts++]        = twopi - angle;
+      } else {
+        const G4double angle = std::asin(side / slope);
+        cuts[nCuts++]        = angle < 0. ? angle + twopi : angle;
+        cuts[nCuts++]        = pi - angle;
+      }
+    }
+  }
+  std::sort(cuts, cuts + nCuts);
+
+  G4double begin[9], length[9];
+  G4int nArcs    = 0;
+  G4double total = 0.;
+  for (G4int i = 0; i + 1 < nCuts; ++i) {
+    const G4double middle = 0.5 * (cuts[i] + cuts[i + 1]);
+    const G4double tx     = slope * std::cos(middle);
+    const G4double ty     = slope * std::sin(middle);
+    if (cuts[i + 1] > cuts[i] && tx >= fSlopeLo[0] && tx <= fSlopeHi[0] &&
+        ty >= fSlopeLo[1] && ty <= fSlopeHi[1]) {
+      begin[nArcs]  = cuts[i];
+      length[nArcs] = cuts[i + 1] - cuts[i];
+      total += length[nArcs++];
+    }
+  }
+  if (nArcs == 0) {
+    phi = 0.;
+    return 0.;
+  }
+
+  G4double u = total * G4UniformRand();
+  for (G4int i = 0; i < nArcs; ++i) {
+    if (u < length[i] || i + 1 == nArcs) {
+      phi = begin[i] + std::min(u, length[i]);
+      break;
+    }
+    u -= length[i];
+  }
+  return total / twopi;
+}
+
+void PrimaryGeneratorAction::GeneratePrimaries(G4Event* anEvent)
+{
+  // this function is called at the begining of each event
+  // Reseed from (seed, run, event) before anything is sampled
+  const auto* run = G4RunManager::GetRunManager()->GetCurrentRun();
+  fEventSeeder->SeedEvent(run->GetRunID(), anEvent->GetEventID());
+  const G4long eventIndex = fEventSeeder->GetEventIndex(anEvent->GetEventID());
+
+  if (fMode == Mode::Library) {
+    ReplayPrimary(anEvent, eventIndex);
+    return;
+  }
+
+  if (fMode != Mode::GPS) {
+    GenerateCosmicMuon(anEvent);
+  } else {
+    // set gun's position
+    fParticleGun->SetParticlePosition(G4ThreeVector(0., 0., -fWorldHalfZ));
+
+    fParticleGun->GeneratePrimaryVertex(anEvent);
+  }
+
+  if (fLibrary->IsWriting()) {
+    fLibrary->Write(eventIndex, *anEvent);
+  }
+}
+
+void PrimaryGeneratorAction::ReplayPrimary(G4Event* anEvent,
+                                           G4long eventIndex)
+{
+  const auto* record = fLibrary->Find(eventIndex);
+  if (!record) {
+    G4ExceptionDescription msg;
+    msg << "The primary library has no event " << eventIndex;
+    G4Exception("PrimaryGeneratorAction::ReplayPrimary()", "MyCode0023",
+                FatalException, msg);
+    return;
+  }
+
+  // Consecutive records are mostly the same particle
+  if (!fReplayed || fReplayed->GetPDGEncoding() != record->pdg) {
+    fReplayed =
+        G4ParticleTable::GetParticleTable()->FindParticle(record->pdg);
+    if (!fReplayed) {
+      fReplayed = G4IonTable::GetIonTable()->GetIon(record->pdg);
+    }
+    if (!fReplayed) {
+      G4ExceptionDescription msg;
+      msg << "Unknown particle " << record->pdg << " in event " << eventIndex
+          << " of the primary library";
+      G4Exception("PrimaryGeneratorAction::ReplayPrimary()", "MyCode0023",
+                  FatalException, msg);
+      return;
+    }
+  }
+
+  fCosmicGun->SetParticleDefinition(fReplayed);
+  fCosmicGun->SetParticleEnergy(record->ekin * MeV);
+  fCosmicGun->SetParticleMomentumDirection(G4ThreeVector(
+      record->direction[0], record->direction[1], record->direction[2]));
+  fCosmicGun->SetParticlePosition(G4ThreeVector(
+      record->position[0] * mm, record->position[1] * mm,
+      record->position[2] * mm));
+  fCosmicGun->SetParticleTime(record->time * ns);
+
+  fCosmicGun->GeneratePrimaryVertex(anEvent);
+  anEvent->GetPrimaryVertex()->SetWeight(record->weight);
+}
+
+void PrimaryGeneratorAction::GenerateCosmicMuon(G4Event* anEvent)
+{
+  G4double ekin     = 0.;
+  G4double cosTheta = 1.;
+  G4double weight   = fSpectrum.Sample(ekin, cosTheta);
+
+  const G4double sinTheta = std::sqrt(1. - cosTheta * cosTheta);
+  const G4bool acceptance = fMode == Mode::Acceptance && !fStack.empty();
+
+  // In the acceptance mode only the azimuths that can cross the stack are
+  // drawn, the weight carries their fraction
+  G4double phi = 0.;
+  if (acceptance) {
+    weight *= SampleAcceptedPhi(sinTheta / cosTheta, phi);
+  } else {
+    phi = twopi * G4UniformRand();
+  }
+
+  // Muons come from the sky (+z) and travel downwards
+  const G4ThreeVector direction(sinTheta * std::cos(phi),
+                                sinTheta * std::sin(phi), -cosTheta);
+  const G4double zPlane = fWorldHalfZ - 1. * um;
+
+  // Origins on the top plane, by default the whole world footprint
+  G4double xlo = -fWorldHalfX, xhi = fWorldHalfX;
+  G4double ylo = -fWorldHalfY, yhi = fWorldHalfY;
+
+  if (acceptance) {
+    StackShadow(direction.x() / cosTheta, direction.y() / cosTheta, xlo, xhi,
+                ylo, yhi);
+
+    // Ratio of the sampled to the full phase space. The drawn directions
+    // all cross the stack, the shadow can only vanish at their edges.
+    if (xlo < xhi && ylo < yhi) {
+      weight *= fAcceptanceFlux * (xhi - xlo) * (yhi - ylo) /
+                (4. * fWorldHalfX * fWorldHalfY);
+    } else {
+      weight = 0.;
+      xlo = xhi = ylo = yhi = 0.;
+    }
+  }
+
+  const G4ThreeVector position(xlo + (xhi - xlo) * G4UniformRand(),
+                               ylo + (yhi - ylo) * G4UniformRand(), zPlane);
+
+  const G4double muPlusFraction = fChargeRatio / (1. + fChargeRatio);
+  fCosmicGun->SetParticleDefinition(
+      G4UniformRand() < muPlusFraction ? fMuonPlus : fMuonMinus);
+  fCosmicGun->SetParticleEnergy(ekin);
+  fCosmicGun->SetParticleMomentumDirection(direction);
+  fCosmicGun->SetParticlePosition(position);
+  fCosmicGun->SetParticleTime(0.);
+
+  fCosmicGun->GeneratePrimaryVertex(anEvent);
+  anEvent->GetPrimaryVertex()->SetWeight(weight);
+}
+
+void PrimaryGeneratorAction::SetMode(const G4String& mode)
+{
+  if (mode == "cosmic") {
+    fMode = Mode::Cosmic;
+  } else if (mode == "acceptance") {
+    fMode = Mode::Acceptance;
+  } else if (mode == "library") {
+    fMode = Mode::Library;
+  } else {
+    fMode = Mode::GPS;
+  }
+}
+
+void PrimaryGeneratorAction::DefineCommands()
+{
+  fMessenger = new G4GenericMessenger(this, "/muon_lab/gun/",
+                                      "Primary generator control");
+
+  auto& modeCmd = fMessenger->DeclareMethod(
+      "mode", &PrimaryGeneratorAction::SetMode,
+      "gps: use the /gps/ commands, cosmic: sea-level cosmic muons, "
+      "acceptance: weighted cosmic muons aimed at the scintillator stack, "
+      "library: replay /muon_lab/library/read");
+  modeCmd.SetParameterName("mode", false);
+  modeCmd.SetCandidates("gps cosmic acceptance library");
+  modeCmd.SetDefaultValue("gps");
+
+  auto& eminCmd = fMessenger->DeclarePropertyWithUnit(
+      "minEnergy", "GeV", fCosmicEmin, "Minimum cosmic muon kinetic energy");
+  eminCmd.SetParameterName("emin", false);
+  eminCmd.SetRange("emin>0.");
+
+  auto& emaxCmd = fMessenger->DeclarePropertyWithUnit(
+      "maxEnergy", "GeV", fCosmicEmax, "Maximum cosmic muon kinetic energy");
+  emaxCmd.SetParameterName("emax", false);
+  emaxCmd.SetRange("emax>0.");
+
+  auto& cosCmd = fMessenger->DeclareProperty(
+      "minCosTheta", fCosmicCosThetaMin,
+      "Minimum cos(zenith angle) of the cosmic muons");
+  cosCmd.SetParameterName("cosmin", false);
+  cosCmd.SetRange("cosmin>=0. && cosmin<1.");
+
+  auto& ratioCmd = fMessenger->DeclareProperty(
+      "chargeRatio", fChargeRatio, "mu+/mu- charge ratio of the cosmic muons");
+  ratioCmd.SetParameterName("ratio", false);
+  ratioCmd.SetRange("ratio>=0.");
+
+  auto& stopCmd = fMessenger->DeclareProperty(
+      "stopBias", fStopBias,
+      "Importance of the cosmic muons that stop in the detector stack, "
+      "1 samples the spectrum without bias");
+  stopCmd.SetParameterName("factor", false);
+  stopCmd.SetRange("factor>0.");
 
-  // set gun's position
-  fParticleGun->SetParticlePosition(G4ThreeVector(0., 0., -worldZHalfLenght));
+  auto& ebinsCmd = fMessenger->DeclareProperty(
+      "energyBins", fEnergyBins, "Logarithmic energy bins of the spectrum");
+  ebinsCmd.SetParameterName("nbins", false);
+  ebinsCmd.SetRange("nbins>0");
 
-  fParticleGun->GeneratePrimaryVertex(anEvent);
+  auto& abinsCmd = fMessenger->DeclareProperty(
+      "angleBins", fAngleBins, "cos(theta) bins of the spectrum");
+  abinsCmd.SetParameterName("nbins", false);
+  abinsCmd.SetRange("nbins>0");
 }
@@ -0,0 +1,174 @@
+#include "PrimaryLibrary.hh"
+
+#include <G4Event.hh>
+#include <G4Exception.hh>
+#include <G4GenericMessenger.hh>
+#include <G4PrimaryParticle.hh>
+#include <G4PrimaryVertex.hh>
+#include <G4SystemOfUnits.hh>
+
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+PrimaryLibrary::PrimaryLibrary()
+    : fMessenger(nullptr), fFd(-1), fWritePath(), fData(nullptr), fSize(0),
+      fNRecords(0)
+{
+  DefineCommands();
+}
+
+PrimaryLibrary::~PrimaryLibrary()
+{
+  delete fMessenger;
+  CloseWrite();
+  CloseRead();
+}
+
+void PrimaryLibrary::Write(G4long eventIndex, const G4Event& event) const
+{
+  const auto* vertex   = event.GetPrimaryVertex();
+  const auto* particle = vertex ? vertex->GetPrimary() : nullptr;
+  if (!particle || eventIndex < 0) {
+    return;
+  }
+
+  primaries::Record record;
+  std::memset(&record, 0, sizeof(record));
+  record.event = eventIndex;
+  record.pdg   = particle->GetPDGcode();
+  record.flags = primaries::kWritten;
+  const auto& direction = particle->GetMomentumDirection();
+  for (G4int k = 0; k < 3; ++k) {
+    record.position[k]  = vertex->GetPosition()[k] / mm;
+    record.direction[k] = direction[k];
+  }
+  record.ekin   = particle->GetKineticEnergy() / MeV;
+  record.time   = vertex->GetT0() / ns;
+  record.weight = vertex->GetWeight();
+
+  // Every event has its own slot, the writers never share a byte
+  if (::pwrite(fFd, &record, sizeof(record),
+               primaries::RecordOffset(eventIndex)) != sizeof(record)) {
+    G4ExceptionDescription msg;
+    msg << "Cannot write event " << eventIndex << " to the primary library "
+        << fWritePath;
+    G4Exception("PrimaryLibrary::Write()", "MyCode0023", JustWarning, msg);
+  }
+}
+
+const primaries::Record* PrimaryLibrary::Find(G4long eventIndex) const
+{
+  if (!fData || eventIndex < 0 || u64(eventIndex) >= fNRecords) {
+    return nullptr;
+  }
+  const auto* record = reinterpret_cast<const primaries::Record*>(
+      fData + primaries::RecordOffset(eventIndex));
+  return (record->flags & primaries::kWritten) && record->event == eventIndex
+             ? record
+             : nullptr;
+}
+
+void PrimaryLibrary::OpenWrite(const G4String& path)
+{
+  CloseWrite();
+  if (path == "none") {
+    return;
+  }
+
+  // Opened once on the master, the workers and forked processes share it
+  fFd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  primaries::FileHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, primaries::kFileMagic, sizeof(header.magic));
+  header.version    = primaries::kVersion;
+  header.recordSize = sizeof(primaries::Record);
+  if (fFd < 0 || ::pwrite(fFd, &header, sizeof(header), 0) != sizeof(header)) {
+    G4ExceptionDescription msg;
+    msg << "Cannot create the primary library " << path;
+    G4Exception("PrimaryLibrary::OpenWrite()", "MyCode0023", JustWarning, msg);
+    CloseWrite();
+    return;
+  }
+  fWritePath = path;
+  G4cout << "INFO: writing the primaries to " << path << G4endl;
+}
+
+void PrimaryLibrary::OpenRead(const G4String& path)
+{
+  CloseRead();
+
+  const int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd >= 0) {
+    struct stat st;
+    if (::fstat(fd, &st) == 0 &&
+        std::size_t(st.st_size) >= sizeof(primaries::FileHeader)) {
+      fSize      = st.st_size;
+      void* data = ::mmap(nullptr, fSize, PROT_READ, MAP_SHARED, fd, 0);
+      fData      = data == MAP_FAILED ? nullptr : static_cast<const u8*>(data);
+    }
+    ::close(fd);
+  }
+
+  const auto* header = reinterpret_cast<const primaries::FileHeader*>(fData);
+  if (!fData ||
+      std::memcmp(header->magic, primaries::kFileMagic,
+                  sizeof(header->magic)) != 0 ||
+      header->version != primaries::kVersion ||
+      header->recordSize != sizeof(primaries::Record)) {
+    G4ExceptionDescription msg;
+    msg << "Cannot map the primary library " << path;
+    G4Exception("PrimaryLibrary::OpenRead()", "MyCode0023", JustWarning, msg);
+    CloseRead();
+    return;
+  }
+
+  fNRecords = (fSize - sizeof(primaries::FileHeader)) /
+              sizeof(primaries::Record);
+  G4cout << "INFO: primary library " << path << ", event indices up to "
+         << fNRecords << G4endl;
+}
+
+void PrimaryLibrary::CloseWrite()
+{
+  if (fFd >= 0) {
+    ::close(fFd);
+  }
+  fFd = -1;
+  fWritePath.clear();
+}
+
+void PrimaryLibrary::CloseRead()
+{
+  if (fData) {
+    ::munmap(const_cast<u8*>(fData), fSize);
+  }
+  fData     = nullptr;
+  fSize     = 0;
+  fNRecords = 0;
+}
+
+void PrimaryLibrary::DefineCommands()
+{
+  fMessenger = new G4GenericMessenger(this, "/muon_lab/library/",
+                                      "Pre-generated primary events");
+
+  // The workers read this object directly, nothing to broadcast
+  auto& writeCmd = fMessenger->DeclareMethod(
+      "write", &PrimaryLibrary::OpenWrite,
+      "Store the primaries of the next events in a new library, none to "
+      "stop");
+  writeCmd.SetParameterName("file", false);
+  writeCmd.SetStates(G4State_PreInit, G4State_Idle);
+  writeCmd.command->SetToBeBroadcasted(false);
+
+  auto& readCmd = fMessenger->DeclareMethod(
+      "read", &PrimaryLibrary::OpenRead,
+      "Library replayed by the library gun mode");
+  readCmd.SetParameterName("file", false);
+  readCmd.SetStates(G4State_PreInit, G4State_Idle);
+  readCmd.command->SetToBeBroadcasted(false);
+}
@@ -0,0 +1,224 @@
+#include "ProgressLogger.hh"
+
+#include <G4GenericMessenger.hh>
+#include <G4SystemOfUnits.hh>
+#include <G4Threading.hh>
+#include <G4ios.hh>
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+ProgressLogger::ProgressLogger()
+    : fMessenger(nullptr), fInterval(10. * s), fVerbose(0), fMaxRecords(20),
+      fStop(true), fRunID(0), fTotalEvents(0)
+{
+  DefineCommands();
+}
+
+ProgressLogger::~ProgressLogger()
+{
+  StopRun();
+  delete fMessenger;
+}
+
+ProgressLogger::Channel* ProgressLogger::GetChannel()
+{
+  static G4ThreadLocal ProgressLogger* owner = nullptr;
+  static G4ThreadLocal Channel* channel      = nullptr;
+
+  // Once per thread, the worker threads live as long as the run manager
+  if (owner != this) {
+    std::lock_guard<std::mutex> lock(fChannelsMutex);
+    fChannels.push_back(std::make_unique<Channel>());
+    channel           = fChannels.back().get();
+    channel->threadID = G4Threading::G4GetThreadId();
+    owner             = this;
+  }
+  return channel;
+}
+
+void ProgressLogger::EventDone()
+{
+  GetChannel()->events.fetch_add(1, std::memory_order_relaxed);
+}
+
+void ProgressLogger::PushRecord(const EventRecord& record)
+{
+  auto* channel   = GetChannel();
+  const auto tail = channel->tail.load(std::memory_order_relaxed);
+  const auto head = channel->head.load(std::memory_order_acquire);
+  if (tail - head >= kRingSize) {
+    channel->dropped.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  channel->ring[tail % kRingSize] = record;
+  channel->tail.store(tail + 1, std::memory_order_release);
+}
+
+void ProgressLogger::StartRun(G4int runID, G4int nEvents)
+{
+  StopRun();
+
+  {
+    // No event is simulated between runs
+    std::lock_guard<std::mutex> lock(fChannelsMutex);
+    for (auto& channel : fChannels) {
+      channel->events.store(0);
+      channel->dropped.store(0);
+      channel->head.store(channel->tail.load());
+      channel->reportedEvents = 0;
+    }
+  }
+
+  fRunID       = runID;
+  fTotalEvents = nEvents;
+  fStart       = std::chrono::steady_clock::now();
+  fLastReport  = fStart;
+  fStop        = false;
+  if (fInterval > 0.) {
+    fReporter = std::thread(&ProgressLogger::Run, this);
+  }
+}
+
+void ProgressLogger::StopRun()
+{
+  if (fStop) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(fStopMutex);
+    fStop = true;
+  }
+  fStopCondition.notify_one();
+  if (fReporter.joinable()) {
+    fReporter.join();
+  }
+  Report(true);
+}
+
+void ProgressLogger::Run()
+{
+  // This thread is not a Geant4 thread, give it its own G4cout
+  G4iosInitialization();
+
+  const std::chrono::duration<double> interval(fInterval / s);
+  std::unique_lock<std::mutex> lock(fStopMutex);
+  while (!fStopCondition.wait_for(lock, interval, [this] { return fStop; })) {
+    lock.unlock();
+    Report(false);
+    lock.lock();
+  }
+
+  G4iosFinalization();
+}
+
+void ProgressLogger::Report(G4bool final)
+{
+  std::vector<Channel*> channels;
+  {
+    std::lock_guard<std::mutex> lock(fChannelsMutex);
+    for (auto& channel : fChannels) {
+      channels.push_back(channel.get());
+    }
+  }
+  std::sort(channels.begin(), channels.end(),
+            [](const Channel* a, const Channel* b) {
+              return a->threadID < b->threadID;
+            });
+
+  const auto now = std::chrono::steady_clock::now();
+  const G4double elapsed =
+      std::chrono::duration<double>(now - fStart).count();
+  const G4double sinceLast =
+      std::chrono::duration<double>(now - fLastReport).count();
+  fLastReport = now;
+
+  G4long events = 0;
+  for (const auto* channel : channels) {
+    events += channel->events.load(std::memory_order_relaxed);
+  }
+  const G4double rate = elapsed > 0. ? events / elapsed : 0.;
+
+  std::ostringstream os;
+  os << std::fixed << std::setprecision(1);
+  os << (final ? "Run " : "Progress run ") << fRunID << ": " << events << "/"
+     << fTotalEvents << " events";
+  if (fTotalEvents > 0) {
+    os << " (" << 100. * events / fTotalEvents << "%)";
+  }
+  os << ", " << rate << " events/s, " << elapsed << " s";
+  if (!final && rate > 0. && fTotalEvents > events) {
+    os << ", ETA " << (fTotalEvents - events) / rate << " s";
+  }
+
+  // Rate of every thread since the last report
+  if (!final && channels.size() > 1 && sinceLast > 0.) {
+    os << " |";
+    for (auto* channel : channels) {
+      const G4long done = channel->events.load(std::memory_order_relaxed);
+      os << " W" << channel->threadID << " "
+         << (done - channel->reportedEvents) / sinceLast;
+      channel->reportedEvents = done;
+    }
+  }
+  os << '\n';
+
+  // Event records, oldest first, at most fMaxRecords of them
+  G4int printed  = 0;
+  G4long skipped = 0;
+  G4long dropped = 0;
+  for (auto* channel : channels) {
+    auto head       = channel->head.load(std::memory_order_relaxed);
+    const auto tail = channel->tail.load(std::memory_order_acquire);
+    for (; head != tail; ++head) {
+      if (printed >= fMaxRecords) {
+        ++skipped;
+        continue;
+      }
+      const auto& record = channel->ring[head % kRingSize];
+      os << "  event " << record.eventID << ": " << record.nHits
+         << " hits, edep";
+      for (G4int i = 0; i < record.nChannels; ++i) {
+        os << ' ' << std::setprecision(3) << record.edep[i] / MeV;
+      }
+      os << " MeV\n";
+      ++printed;
+    }
+    channel->head.store(head, std::memory_order_release);
+    dropped += channel->dropped.exchange(0, std::memory_order_relaxed);
+  }
+  if (skipped + dropped > 0) {
+    os << "  " << skipped + dropped << " event records not shown\n";
+  }
+
+  G4cout << os.str() << std::flush;
+}
+
+void ProgressLogger::DefineCommands()
+{
+  fMessenger =
+      new G4GenericMessenger(this, "/muon_lab/log/", "Progress reporting");
+
+  // The workers read this object directly, nothing to broadcast
+  auto& intervalCmd = fMessenger->DeclarePropertyWithUnit(
+      "interval", "s", fInterval,
+      "Time between two progress reports, 0 for the final report only");
+  intervalCmd.SetParameterName("interval", false);
+  intervalCmd.SetRange("interval>=0.");
+  intervalCmd.SetStates(G4State_PreInit, G4State_Idle);
+  intervalCmd.command->SetToBeBroadcasted(false);
+
+  auto& verboseCmd = fMessenger->DeclareProperty(
+      "verbose", fVerbose, "1: report the energy deposits of every event");
+  verboseCmd.SetParameterName("verbose", false);
+  verboseCmd.SetStates(G4State_PreInit, G4State_Idle);
+  verboseCmd.command->SetToBeBroadcasted(false);
+
+  auto& recordsCmd = fMessenger->DeclareProperty(
+      "maxRecords", fMaxRecords, "Event records printed per report");
+  recordsCmd.SetParameterName("n", false);
+  recordsCmd.SetRange("n>=0");
+  recordsCmd.SetStates(G4State_PreInit, G4State_Idle);
+  recordsCmd.command->SetToBeBroadcasted(false);
+}
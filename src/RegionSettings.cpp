@@ -0,0 +1,160 @@
+#include "RegionSettings.hh"
+
+#include <G4Exception.hh>
+#include <G4GenericMessenger.hh>
+#include <G4LogicalVolume.hh>
+#include <G4ProductionCuts.hh>
+#include <G4Region.hh>
+#include <G4RegionStore.hh>
+#include <G4SystemOfUnits.hh>
+#include <G4UnitsTable.hh>
+#include <G4UserLimits.hh>
+
+#include <cfloat>
+#include <sstream>
+
+RegionSettings::RegionSettings() : fMessenger(nullptr)
+{
+  // The world air keeps the default cut of the physics list
+  fCut[kWorld]        = 0.;
+  fCut[kAbsorber]     = 1. * mm;
+  fCut[kScintillator] = 0.1 * mm;
+  for (G4int i = 0; i < kNRegions; ++i) {
+    fMaxStep[i]          = DBL_MAX;
+    fMinKineticEnergy[i] = 0.;
+    fLimits[i]           = nullptr;
+  }
+
+  DefineCommands();
+}
+
+RegionSettings::~RegionSettings()
+{
+  delete fMessenger;
+  for (auto* limits : fLimits) {
+    delete limits;
+  }
+}
+
+const char* RegionSettings::GetName(RegionIndex index)
+{
+  switch (index) {
+  case kWorld:
+    return "DefaultRegionForTheWorld";
+  case kAbsorber:
+    return "Absorber";
+  case kScintillator:
+    return "Scintillator";
+  default:
+    return "";
+  }
+}
+
+void RegionSettings::Build(const std::vector<G4LogicalVolume*>& absorberLVs,
+                           const std::vector<G4LogicalVolume*>& scintillatorLVs)
+{
+  auto* absorberCuts = new G4ProductionCuts();
+  absorberCuts->SetProductionCut(fCut[kAbsorber]);
+  auto* absorberRegion = new G4Region(GetName(kAbsorber));
+  absorberRegion->SetProductionCuts(absorberCuts);
+  for (auto* lv : absorberLVs) {
+    absorberRegion->AddRootLogicalVolume(lv);
+  }
+
+  auto* scintillatorCuts = new G4ProductionCuts();
+  scintillatorCuts->SetProductionCut(fCut[kScintillator]);
+  auto* scintillatorRegion = new G4Region(GetName(kScintillator));
+  scintillatorRegion->SetProductionCuts(scintillatorCuts);
+  for (auto* lv : scintillatorLVs) {
+    scintillatorRegion->AddRootLogicalVolume(lv);
+  }
+
+  for (G4int i = 0; i < kNRegions; ++i) {
+    const auto index = static_cast<RegionIndex>(i);
+    delete fLimits[i];
+    fLimits[i] = new G4UserLimits(fMaxStep[i], DBL_MAX, DBL_MAX,
+                                  fMinKineticEnergy[i]);
+    G4RegionStore::GetInstance()
+        ->GetRegion(GetName(index))
+        ->SetUserLimits(fLimits[i]);
+  }
+}
+
+G4bool RegionSettings::Parse(const G4String& setting,
+                             const char* unitCategory, RegionIndex& index,
+                             G4double& value) const
+{
+  std::istringstream is(setting);
+  std::string name, unit;
+  is >> name >> value >> unit;
+
+  G4bool valid = !is.fail() && value >= 0. &&
+                 G4UnitDefinition::GetCategory(unit) == unitCategory;
+  index = kNRegions;
+  for (G4int i = 0; i < kNRegions; ++i) {
+    if (name == GetName(static_cast<RegionIndex>(i)) ||
+        (i == kWorld && name == "World")) {
+      index = static_cast<RegionIndex>(i);
+    }
+  }
+
+  if (!valid || index == kNRegions) {
+    G4ExceptionDescription msg;
+    msg << "Invalid region setting \"" << setting << "\"" << G4endl;
+    msg << "Use <World|Absorber|Scintillator> <value> <unit>";
+    G4Exception("RegionSettings::Parse()", "MyCode0012", JustWarning, msg);
+    return false;
+  }
+
+  value *= G4UnitDefinition::GetValueOf(unit);
+  return true;
+}
+
+void RegionSettings::SetMaxStep(const G4String& setting)
+{
+  RegionIndex index;
+  G4double value;
+  if (!Parse(setting, "Length", index, value)) {
+    return;
+  }
+  fMaxStep[index] = value > 0. ? value : DBL_MAX;
+  if (fLimits[index]) {
+    fLimits[index]->SetMaxAllowedStep(fMaxStep[index]);
+  }
+}
+
+void RegionSettings::SetMinKineticEnergy(const G4String& setting)
+{
+  RegionIndex index;
+  G4double value;
+  if (!Parse(setting, "Energy", index, value)) {
+    return;
+  }
+  fMinKineticEnergy[index] = value;
+  if (fLimits[index]) {
+    fLimits[index]->SetUserMinEkine(value);
+  }
+}
+
+void RegionSettings::DefineCommands()
+{
+  fMessenger =
+      new G4GenericMessenger(this, "/muon_lab/limits/", "Region user limits");
+
+  // The limits are shared with the workers, nothing to broadcast
+  auto& maxStepCmd = fMessenger->DeclareMethod(
+      "maxStep", &RegionSettings::SetMaxStep,
+      "Maximum step in a region: <World|Absorber|Scintillator> <value> "
+      "<unit>, 0 for none");
+  maxStepCmd.SetParameterName("setting", false);
+  maxStepCmd.SetStates(G4State_PreInit, G4State_Idle);
+  maxStepCmd.command->SetToBeBroadcasted(false);
+
+  auto& minEkinCmd = fMessenger->DeclareMethod(
+      "minEkin", &RegionSettings::SetMinKineticEnergy,
+      "Kill tracks below this kinetic energy in a region: "
+      "<World|Absorber|Scintillator> <value> <unit>");
+  minEkinCmd.SetParameterName("setting", false);
+  minEkinCmd.SetStates(G4State_PreInit, G4State_Idle);
+  minEkinCmd.command->SetToBeBroadcasted(false);
+}
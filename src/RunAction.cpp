@@ -1,22 +1,51 @@
 #include "RunAction.hh"
 #include "Analysis.hh"
 #include "DetectorConstruction.hh"
+#include "PhysicsList.hh"
 #include "PrimaryGeneratorAction.hh"
 
+#include <G4AccumulableManager.hh>
+#include <G4Exception.hh>
 #include <G4Run.hh>
 #include <G4RunManager.hh>
 #include <G4SystemOfUnits.hh>
+#include <G4Threading.hh>
 #include <G4UnitsTable.hh>
 
+#include <algorithm>
+
 RunAction::RunAction(EventAction* eventAction,
                      DetectorConstruction* detConstruction,
-                     PrimaryGeneratorAction* primaryGenAction)
+                     PrimaryGeneratorAction* primaryGenAction,
+                     ProgressLogger* progressLogger,
+                     const ColumnarOutput* columnarOutput,
+                     Checkpoint* checkpoint, VoxelScoring* voxelScoring)
     : G4UserRunAction(), fEventAction(eventAction),
       fDetConstruction(detConstruction),
-      fPrimaryGeneratorAction(primaryGenAction)
+      fPrimaryGeneratorAction(primaryGenAction),
+      fProgressLogger(progressLogger), fColumnarOutput(columnarOutput),
+      fCheckpoint(checkpoint), fColumnarWriter(),
+      fVoxelScoring(voxelScoring), fVoxelScorer(), fCounters()
 {
-  // print event number after each event
-  G4RunManager::GetRunManager()->SetPrintProgress(1);
+  // Stacking counters, merged from the workers at the end of run
+  auto accumulableManager = G4AccumulableManager::Instance();
+  for (G4int i = 0; i < StackingPolicy::kNTrackClasses; ++i) {
+    accumulableManager->RegisterAccumulable(fKilledTracks[i]);
+    accumulableManager->RegisterAccumulable(fKilledEnergy[i]);
+    accumulableManager->RegisterAccumulable(fSurvivedTracks[i]);
+  }
+  for (auto& secondaries : fSecondaries) {
+    accumulableManager->RegisterAccumulable(secondaries);
+  }
+  accumulableManager->RegisterAccumulable(fAccepted);
+  accumulableManager->RegisterAccumulable(fRejected);
+  accumulableManager->RegisterAccumulable(fAborted);
+  accumulableManager->RegisterAccumulable(fOutputBlocks);
+  accumulableManager->RegisterAccumulable(fOutputStalls);
+  accumulableManager->RegisterAccumulable(fOutputStallTime);
+  accumulableManager->RegisterAccumulable(fOutputQueueDepth);
+
+  fEventAction->SetRunAction(this);
 
   // create the analysis manager
   // the analysis method is choosed from myAnalysis.hh
@@ -43,19 +72,119 @@ RunAction::RunAction(EventAction* eventAction,
   analysisManager->CreateNtupleDColumn("eDep", fEventAction->fParticles.edep);
   analysisManager->CreateNtupleDColumn("posX", fEventAction->fParticles.posX);
   analysisManager->CreateNtupleDColumn("posY", fEventAction->fParticles.posY);
+  analysisManager->CreateNtupleDColumn("hitWeight",
+                                       fEventAction->fParticles.weight);
+  // photoelectrons from the fast optical model, scintillators with any only
+  analysisManager->CreateNtupleIColumn("peChannel", fEventAction->fPEChannels);
+  analysisManager->CreateNtupleIColumn("nPE", fEventAction->fPhotoelectrons);
+  // per event weight of the primary vertex
+  fEventAction->SetWeightColumnID(
+      analysisManager->CreateNtupleDColumn("weight"));
+  // run and event indices of the event seeding
+  const G4int runColumnID = analysisManager->CreateNtupleIColumn("run");
+  fEventAction->SetEventColumnIDs(
+      runColumnID, analysisManager->CreateNtupleIColumn("event"));
+  analysisManager->FinishNtuple();
+
+  // one row per run, filled by the master
+  analysisManager->CreateNtuple("RunInfo", "run metadata");
+  analysisManager->CreateNtupleIColumn("run");
+  analysisManager->CreateNtupleSColumn("profile");
+  analysisManager->CreateNtupleIColumn("events");
+  analysisManager->CreateNtupleDColumn("realTime");
+  // events that passed and failed the trigger, no 64-bit integer columns
+  analysisManager->CreateNtupleDColumn("accepted");
+  analysisManager->CreateNtupleDColumn("rejected");
+  analysisManager->FinishNtuple();
+
+  // PMT digits, one row per event when the digitizer is enabled
+  auto& digits = fEventAction->fDigits;
+  analysisManager->CreateNtuple("Digits", "PMT digitizer records");
+  fEventAction->SetDigitColumnID(analysisManager->CreateNtupleIColumn("run"));
+  analysisManager->CreateNtupleIColumn("event");
+  analysisManager->CreateNtupleDColumn("weight");
+  analysisManager->CreateNtupleDColumn("windowStart");
+  analysisManager->CreateNtupleIColumn("channel", digits.channel);
+  analysisManager->CreateNtupleDColumn("time", digits.time);
+  analysisManager->CreateNtupleDColumn("charge", digits.charge);
+  analysisManager->CreateNtupleDColumn("peak", digits.peak);
+  analysisManager->CreateNtupleFColumn("samples", digits.samples);
   analysisManager->FinishNtuple();
 }
 
 RunAction::~RunAction() { delete G4AnalysisManager::Instance(); }
 
-void RunAction::BeginOfRunAction(const G4Run*)
+void RunAction::BeginOfRunAction(const G4Run* aRun)
 {
+  // Only the threads that simulate events generate primaries, the MT
+  // master does not need the generator tables
+  const G4bool simulates =
+      !IsMaster() || !G4Threading::IsMultithreadedApplication();
+
+  // Build the generator tables once per run
+  if (simulates) {
+    fPrimaryGeneratorAction->BeginOfRun();
+  }
+
+  // Scintillation photons are only tracked without the fast optical model
+  fDetConstruction->GetOpticalModel().ApplyProcessActivation();
+
+  // Sample the PMT kernel with the digitizer settings of this run
+  fEventAction->BeginOfRun(fDetConstruction->GetOpticalModel());
+
+  G4AccumulableManager::Instance()->Reset();
+
   auto analysisManager = G4AnalysisManager::Instance();
 
   // The default name is given in the constructor
   // extra naming functionality exist through the
   // macro /analysis/setFileName filename
   analysisManager->OpenFile();
+
+  // Before the workers open their files
+  if (IsMaster()) {
+    if (fCheckpoint->IsEnabled() &&
+        !(fColumnarOutput->IsEnabled() && fEventAction->IsWritingHits())) {
+      G4ExceptionDescription msg;
+      msg << "Checkpoints only record the events in columnar files" << G4endl;
+      msg << "Every event is simulated again on resume without "
+          << "/muon_lab/output/columnar true, and with the digitizer without "
+          << "/muon_lab/digi/keepHits true";
+      G4Exception("RunAction::BeginOfRunAction()", "MyCode0016", JustWarning,
+                  msg);
+    }
+    fCheckpoint->BeginRun(aRun->GetRunID(),
+                          aRun->GetNumberOfEventToBeProcessed());
+  }
+
+  // Every thread that simulates events writes its own columnar file
+  if (simulates && fColumnarOutput->IsEnabled() &&
+      fEventAction->IsWritingHits()) {
+    const G4int thread = std::max(0, G4Threading::G4GetThreadId());
+    fColumnarWriter.Open(fColumnarOutput->GetPath(aRun->GetRunID(), thread),
+                         aRun->GetRunID(), thread,
+                         fColumnarOutput->GetFields(),
+                         fColumnarOutput->GetBlockRows(),
+                         fColumnarOutput->GetBlockEvents(),
+                         fColumnarOutput->GetBuffers(), fCheckpoint);
+  }
+  fEventAction->SetColumnarWriter(
+      fColumnarWriter.IsOpen() ? &fColumnarWriter : nullptr);
+
+  // The master builds the grid before the workers start their run
+  if (IsMaster()) {
+    fVoxelScoring->BeginOfRun();
+  }
+  fVoxelScorer.Reset(simulates ? fVoxelScoring->GetGrid() : VoxelGrid());
+  fEventAction->SetNtupleEnabled(fColumnarOutput->IsNtupleEnabled() &&
+                                 fEventAction->IsWritingHits());
+
+  if (IsMaster()) {
+    G4cout << "INFO: physics profile " << GetPhysicsProfile() << G4endl;
+    fTimer.Start();
+    fProgressLogger->StartRun(aRun->GetRunID(),
+                              aRun->GetNumberOfEventToBeProcessed());
+  }
 }
 
 void RunAction::EndOfRunAction(const G4Run* aRun)
@@ -64,7 +193,146 @@ void RunAction::EndOfRunAction(const G4Run* aRun)
   G4int n_run          = aRun->GetRunID();
   G4cout << "INFO: run : " << n_run << G4endl;
 
+  if (fColumnarWriter.IsOpen()) {
+    fColumnarWriter.Close();
+    const auto& stats = fColumnarWriter.GetStats();
+    fOutputBlocks += stats.blocks;
+    fOutputStalls += stats.stalls;
+    fOutputStallTime += stats.stallTime;
+    fOutputQueueDepth += stats.queueDepth;
+  }
+
+  if (fVoxelScorer.IsActive()) {
+    fVoxelScoring->Publish(&fVoxelScorer);
+  }
+
+  G4AccumulableManager::Instance()->Merge();
+  if (IsMaster()) {
+    fVoxelScoring->EndOfRun(n_run, aRun->GetNumberOfEvent());
+    fProgressLogger->StopRun();
+    fCheckpoint->EndRun();
+    fCounters = CollectCounters();
+    PrintSummaries(fCounters);
+
+    fTimer.Stop();
+    const G4int nEvents     = aRun->GetNumberOfEvent();
+    const G4double realTime = fTimer.GetRealElapsed();
+    G4cout << "INFO: " << nEvents << " events in " << realTime << " s";
+    if (realTime > 0.) {
+      G4cout << ", " << nEvents / realTime << " events/s";
+    }
+    G4cout << " (" << GetPhysicsProfile() << ")" << G4endl;
+
+    analysisManager->FillNtupleIColumn(1, 0, n_run);
+    analysisManager->FillNtupleSColumn(1, 1, GetPhysicsProfile());
+    analysisManager->FillNtupleIColumn(1, 2, nEvents);
+    analysisManager->FillNtupleDColumn(1, 3, realTime);
+    analysisManager->FillNtupleDColumn(1, 4, fAccepted.GetValue());
+    analysisManager->FillNtupleDColumn(1, 5, fRejected.GetValue());
+    analysisManager->AddNtupleRow(1);
+  }
+
   // save and close the file
   analysisManager->Write();
   analysisManager->CloseFile();
 }
+
+G4String RunAction::GetPhysicsProfile() const
+{
+  const auto* physicsList = static_cast<const PhysicsList*>(
+      G4RunManager::GetRunManager()->GetUserPhysicsList());
+  return physicsList->GetProfile();
+}
+
+RunAction::Counters&
+RunAction::Counters::operator+=(const Counters& other)
+{
+  for (G4int i = 0; i < StackingPolicy::kNTrackClasses; ++i) {
+    killedTracks[i] += other.killedTracks[i];
+    killedEnergy[i] += other.killedEnergy[i];
+    survivedTracks[i] += other.survivedTracks[i];
+  }
+  for (G4int i = 0; i < RegionSettings::kNRegions; ++i) {
+    secondaries[i] += other.secondaries[i];
+  }
+  accepted += other.accepted;
+  rejected += other.rejected;
+  aborted += other.aborted;
+  outputBlocks += other.outputBlocks;
+  outputStalls += other.outputStalls;
+  outputStallTime += other.outputStallTime;
+  outputQueueDepth += other.outputQueueDepth;
+  return *this;
+}
+
+RunAction::Counters RunAction::CollectCounters() const
+{
+  Counters counters{};
+  for (G4int i = 0; i < StackingPolicy::kNTrackClasses; ++i) {
+    counters.killedTracks[i]   = fKilledTracks[i].GetValue();
+    counters.killedEnergy[i]   = fKilledEnergy[i].GetValue();
+    counters.survivedTracks[i] = fSurvivedTracks[i].GetValue();
+  }
+  for (G4int i = 0; i < RegionSettings::kNRegions; ++i) {
+    counters.secondaries[i] = fSecondaries[i].GetValue();
+  }
+  counters.accepted         = fAccepted.GetValue();
+  counters.rejected         = fRejected.GetValue();
+  counters.aborted          = fAborted.GetValue();
+  counters.outputBlocks     = fOutputBlocks.GetValue();
+  counters.outputStalls     = fOutputStalls.GetValue();
+  counters.outputStallTime  = fOutputStallTime.GetValue();
+  counters.outputQueueDepth = fOutputQueueDepth.GetValue();
+  return counters;
+}
+
+void RunAction::PrintSummaries(const Counters& counters)
+{
+  PrintStackingSummary(counters);
+  PrintOutputSummary(counters);
+  PrintTriggerSummary(counters);
+}
+
+void RunAction::PrintTriggerSummary(const Counters& counters)
+{
+  if (counters.rejected == 0) {
+    return;
+  }
+  G4cout << "INFO: trigger: " << counters.accepted << " accepted, "
+         << counters.rejected << " rejected (" << counters.aborted
+         << " aborted early)" << G4endl;
+}
+
+void RunAction::PrintOutputSummary(const Counters& counters)
+{
+  const G4int blocks = counters.outputBlocks;
+  if (blocks == 0) {
+    return;
+  }
+  // A mean depth close to the number of buffers means the disk is the
+  // bottleneck and the stalls show how long the event loops waited for it
+  G4cout << "INFO: columnar output: " << blocks << " blocks, mean queue depth "
+         << G4double(counters.outputQueueDepth) / blocks << ", "
+         << counters.outputStalls << " stalls (" << counters.outputStallTime
+         << " s)" << G4endl;
+}
+
+void RunAction::PrintStackingSummary(const Counters& counters)
+{
+  G4cout << "INFO: secondaries produced per region" << G4endl;
+  for (G4int i = 0; i < RegionSettings::kNRegions; ++i) {
+    const auto region = static_cast<RegionSettings::RegionIndex>(i);
+    G4cout << "  " << RegionSettings::GetName(region) << " : "
+           << counters.secondaries[i] << G4endl;
+  }
+
+  G4cout << "INFO: stacking summary" << G4endl;
+  for (G4int i = 0; i < StackingPolicy::kNTrackClasses; ++i) {
+    const auto trackClass = static_cast<StackingPolicy::TrackClass>(i);
+    G4cout << "  " << StackingPolicy::GetClassName(trackClass)
+           << " : killed " << counters.killedTracks[i] << " ("
+           << G4BestUnit(counters.killedEnergy[i], "Energy")
+           << "), rouletted survivors " << counters.survivedTracks[i]
+           << G4endl;
+  }
+}
@@ -0,0 +1,114 @@
+#include "ScintillatorHitFilter.hh"
+
+#include <G4Electron.hh>
+#include <G4Exception.hh>
+#include <G4GenericMessenger.hh>
+#include <G4ParticleTable.hh>
+
+#include <cstdlib>
+
+ScintillatorHitFilter::ScintillatorHitFilter()
+    : fMessenger(nullptr), fParticles{G4Electron::Definition()},
+      fFirstStepOnly(true), fEdepThreshold(0.), fEkinThreshold(0.)
+{
+  DefineCommands();
+}
+
+ScintillatorHitFilter::~ScintillatorHitFilter() { delete fMessenger; }
+
+void ScintillatorHitFilter::AddParticle(const G4String& particle)
+{
+  auto* particleTable = G4ParticleTable::GetParticleTable();
+
+  // A plain integer is a PDG encoding, anything else a particle name
+  char* end                        = nullptr;
+  const long encoding              = std::strtol(particle.c_str(), &end, 10);
+  G4ParticleDefinition* definition = nullptr;
+  if (end != particle.c_str() && *end == '\0') {
+    definition = particleTable->FindParticle(static_cast<G4int>(encoding));
+  } else {
+    definition = particleTable->FindParticle(particle);
+  }
+
+  if (!definition) {
+    G4ExceptionDescription msg;
+    msg << "Unknown particle " << particle << ", the hit filter is unchanged";
+    G4Exception("ScintillatorHitFilter::AddParticle()", "MyCode0007",
+                JustWarning, msg);
+    return;
+  }
+
+  if (std::find(fParticles.begin(), fParticles.end(), definition) ==
+      fParticles.end()) {
+    fParticles.push_back(definition);
+  }
+}
+
+void ScintillatorHitFilter::ClearParticles() { fParticles.clear(); }
+
+void ScintillatorHitFilter::AddDetector(G4int channel)
+{
+  if (channel >= static_cast<G4int>(fDetectors.size())) {
+    fDetectors.resize(channel + 1, 0);
+  }
+  fDetectors[channel] = 1;
+}
+
+void ScintillatorHitFilter::ClearDetectors() { fDetectors.clear(); }
+
+void ScintillatorHitFilter::DefineCommands()
+{
+  fMessenger =
+      new G4GenericMessenger(this, "/muon_lab/hits/", "Hit selection");
+
+  // The workers read this object directly, nothing to broadcast
+  auto& addParticleCmd = fMessenger->DeclareMethod(
+      "addParticle", &ScintillatorHitFilter::AddParticle,
+      "Record the steps of this particle (name or PDG encoding)");
+  addParticleCmd.SetParameterName("particle", false);
+  addParticleCmd.SetStates(G4State_PreInit, G4State_Idle);
+  addParticleCmd.command->SetToBeBroadcasted(false);
+
+  auto& clearParticlesCmd = fMessenger->DeclareMethod(
+      "clearParticles", &ScintillatorHitFilter::ClearParticles,
+      "Record the steps of every particle");
+  clearParticlesCmd.SetStates(G4State_PreInit, G4State_Idle);
+  clearParticlesCmd.command->SetToBeBroadcasted(false);
+
+  auto& addDetectorCmd = fMessenger->DeclareMethod(
+      "addDetector", &ScintillatorHitFilter::AddDetector,
+      "Record the steps in this scintillator (copy number)");
+  addDetectorCmd.SetParameterName("detector", false);
+  addDetectorCmd.SetRange("detector>=0");
+  addDetectorCmd.SetStates(G4State_PreInit, G4State_Idle);
+  addDetectorCmd.command->SetToBeBroadcasted(false);
+
+  auto& clearDetectorsCmd = fMessenger->DeclareMethod(
+      "clearDetectors", &ScintillatorHitFilter::ClearDetectors,
+      "Record the steps in every scintillator");
+  clearDetectorsCmd.SetStates(G4State_PreInit, G4State_Idle);
+  clearDetectorsCmd.command->SetToBeBroadcasted(false);
+
+  auto& firstStepCmd = fMessenger->DeclareProperty(
+      "firstStepOnly", fFirstStepOnly,
+      "Record only the first step of a track in a scintillator");
+  firstStepCmd.SetParameterName("flag", false);
+  firstStepCmd.SetStates(G4State_PreInit, G4State_Idle);
+  firstStepCmd.command->SetToBeBroadcasted(false);
+
+  auto& edepCmd = fMessenger->DeclarePropertyWithUnit(
+      "edepThreshold", "keV", fEdepThreshold,
+      "Record steps depositing more than this energy");
+  edepCmd.SetParameterName("edep", false);
+  edepCmd.SetRange("edep>=0.");
+  edepCmd.SetStates(G4State_PreInit, G4State_Idle);
+  edepCmd.command->SetToBeBroadcasted(false);
+
+  auto& ekinCmd = fMessenger->DeclarePropertyWithUnit(
+      "ekinThreshold", "keV", fEkinThreshold,
+      "Record steps starting with at least this kinetic energy");
+  ekinCmd.SetParameterName("ekin", false);
+  ekinCmd.SetRange("ekin>=0.");
+  ekinCmd.SetStates(G4State_PreInit, G4State_Idle);
+  ekinCmd.command->SetToBeBroadcasted(false);
+}
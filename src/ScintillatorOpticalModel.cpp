@@ -0,0 +1,115 @@
+#include "ScintillatorOpticalModel.hh"
+
+#include <G4EmSaturation.hh>
+#include <G4Exception.hh>
+#include <G4GenericMessenger.hh>
+#include <G4LossTableManager.hh>
+#include <G4Material.hh>
+#include <G4MaterialPropertiesTable.hh>
+#include <G4Poisson.hh>
+#include <G4ProcessTable.hh>
+#include <G4Step.hh>
+#include <G4SystemOfUnits.hh>
+#include <Randomize.hh>
+
+#include <cmath>
+
+ScintillatorOpticalModel::ScintillatorOpticalModel()
+    : fMessenger(nullptr), fEnabled(true), fEfficiency(0.05),
+      fTransitTime(5. * ns), fTransitTimeSpread(1. * ns), fYield(0.),
+      fDecayTime(0.)
+{
+  DefineCommands();
+}
+
+ScintillatorOpticalModel::~ScintillatorOpticalModel() { delete fMessenger; }
+
+void ScintillatorOpticalModel::SetScintillator(const G4Material* material)
+{
+  const auto* mpt = material->GetMaterialPropertiesTable();
+  if (!mpt || !mpt->ConstPropertyExists("SCINTILLATIONYIELD")) {
+    G4ExceptionDescription msg;
+    msg << material->GetName() << " has no scintillation properties" << G4endl;
+    msg << "The fast optical model will not produce photoelectrons";
+    G4Exception("ScintillatorOpticalModel::SetScintillator()", "MyCode0008",
+                JustWarning, msg);
+    fYield = fDecayTime = 0.;
+    return;
+  }
+
+  fYield     = mpt->GetConstProperty("SCINTILLATIONYIELD");
+  fDecayTime = mpt->ConstPropertyExists("FASTTIMECONSTANT")
+                   ? mpt->GetConstProperty("FASTTIMECONSTANT")
+                   : 0.;
+}
+
+void ScintillatorOpticalModel::ApplyProcessActivation() const
+{
+  G4ProcessTable::GetProcessTable()->SetProcessActivation("Scintillation",
+                                                           !fEnabled);
+}
+
+G4int ScintillatorOpticalModel::SamplePhotoelectrons(
+    const G4Step* step, std::vector<float>& times) const
+{
+  const G4double visible =
+      G4LossTableManager::Instance()->EmSaturation()
+          ->VisibleEnergyDepositionAtAStep(step);
+  const G4double mean = visible * fYield * fEfficiency;
+  if (mean <= 0.) {
+    return 0;
+  }
+
+  const G4int npe = G4Poisson(mean);
+
+  // Emission uniformly in time along the step
+  const G4double t0 = step->GetPreStepPoint()->GetGlobalTime();
+  const G4double dt = step->GetPostStepPoint()->GetGlobalTime() - t0;
+  for (G4int i = 0; i < npe; ++i) {
+    G4double t = t0 + dt * G4UniformRand() + fTransitTime;
+    if (fDecayTime > 0.) {
+      t -= fDecayTime * std::log(G4UniformRand());
+    }
+    if (fTransitTimeSpread > 0.) {
+      t += G4RandGauss::shoot(0., fTransitTimeSpread);
+    }
+    times.push_back(t / ns);
+  }
+  return npe;
+}
+
+void ScintillatorOpticalModel::DefineCommands()
+{
+  fMessenger = new G4GenericMessenger(this, "/muon_lab/optical/",
+                                      "Scintillator optical response");
+
+  // The workers read this object directly, nothing to broadcast
+  auto& fastCmd = fMessenger->DeclareProperty(
+      "fastModel", fEnabled,
+      "Parametrize the scintillation light instead of tracking photons");
+  fastCmd.SetParameterName("flag", false);
+  fastCmd.SetStates(G4State_PreInit, G4State_Idle);
+  fastCmd.command->SetToBeBroadcasted(false);
+
+  auto& effCmd = fMessenger->DeclareProperty(
+      "efficiency", fEfficiency,
+      "Photoelectrons per scintillation photon (collection x QE)");
+  effCmd.SetParameterName("eff", false);
+  effCmd.SetRange("eff>=0. && eff<=1.");
+  effCmd.SetStates(G4State_PreInit, G4State_Idle);
+  effCmd.command->SetToBeBroadcasted(false);
+
+  auto& ttCmd = fMessenger->DeclarePropertyWithUnit(
+      "transitTime", "ns", fTransitTime, "Mean PMT transit time");
+  ttCmd.SetParameterName("tt", false);
+  ttCmd.SetStates(G4State_PreInit, G4State_Idle);
+  ttCmd.command->SetToBeBroadcasted(false);
+
+  auto& ttsCmd = fMessenger->DeclarePropertyWithUnit(
+      "transitTimeSpread", "ns", fTransitTimeSpread,
+      "Sigma of the PMT transit time");
+  ttsCmd.SetParameterName("tts", false);
+  ttsCmd.SetRange("tts>=0.");
+  ttsCmd.SetStates(G4State_PreInit, G4State_Idle);
+  ttsCmd.command->SetToBeBroadcasted(false);
+}
@@ -2,66 +2,122 @@
 #include "Analysis.hh"
 
 #include <G4HCofThisEvent.hh>
+#include <G4LogicalVolume.hh>
 #include <G4SDManager.hh>
+#include <G4SystemOfUnits.hh>
 #include <G4Track.hh>
+#include <G4VPhysicalVolume.hh>
 #include <G4VProcess.hh>
+#include <G4VTouchable.hh>
 
-ScintillatorSD::ScintillatorSD(G4String name)
-    : G4VSensitiveDetector(std::move(name)), fScintHitCollection(nullptr)
+#include <algorithm>
+#include <cfloat>
+
+ScintillatorSD::ScintillatorSD(G4String name, G4int nChannels,
+                               const ScintillatorHitFilter* filter,
+                               const ScintillatorOpticalModel* opticalModel)
+    : G4VSensitiveDetector(std::move(name)), fFilter(filter),
+      fOpticalModel(opticalModel), fEdep(nChannels, 0.),
+      fDeposit(nChannels, 0.), fFirstTime(nChannels, DBL_MAX),
+      fPhotoelectrons(nChannels, 0)
 {
-  G4String HCname;
-  collectionName.insert(HCname = "ScintParticleCollection");
 }
 
 ScintillatorSD::~ScintillatorSD() {}
 
-void ScintillatorSD::Initialize(G4HCofThisEvent* HCE)
+void ScintillatorSD::Initialize(G4HCofThisEvent*)
 {
-  fScintHitCollection =
-      new ScintillatorHitsCollection(SensitiveDetectorName, collectionName[0]);
-
-  static G4int HCID = -1;
-  if (HCID < 0) {
-    HCID = G4SDManager::GetSDMpointer()->GetCollectionID(collectionName[0]);
+  fHitBuffer.Clear();
+  // A large array sees a few channels per event, the others are still zero
+  for (const G4int channel : fTouched) {
+    fEdep[channel]           = 0.;
+    fDeposit[channel]        = 0.;
+    fFirstTime[channel]      = DBL_MAX;
+    fPhotoelectrons[channel] = 0;
   }
+  fTouched.clear();
+  fPEChannels.clear();
+  fPETimes.clear();
+}
 
-  HCE->AddHitsCollection(HCID, fScintHitCollection);
+void ScintillatorSD::AddArray(const G4LogicalVolume* paddleLV, G4int first,
+                              G4int stride)
+{
+  fArrays.push_back({paddleLV, first, stride});
+}
+
+G4int ScintillatorSD::GetChannel(const G4VTouchable* touchable) const
+{
+  // A handful of arrays at most, cheaper than a map lookup
+  const auto* lv = touchable->GetVolume()->GetLogicalVolume();
+  for (const auto& array : fArrays) {
+    if (array.paddleLV == lv) {
+      return array.first + touchable->GetCopyNumber(0) +
+             array.stride * touchable->GetCopyNumber(1);
+    }
+  }
+  return touchable->GetCopyNumber();
 }
 
 G4bool ScintillatorSD::ProcessHits(G4Step* aStep, G4TouchableHistory*)
 {
-  G4Track* theTrack = aStep->GetTrack();
-  auto particleName = theTrack->GetParticleDefinition()->GetParticleName();
+  const auto* preStep = aStep->GetPreStepPoint();
+  const G4int channel = GetChannel(preStep->GetTouchable());
+  const G4double edep = aStep->GetTotalEnergyDeposit();
 
-  // TODO(#3): Save only electrons and their first step
-  if (particleName == "e-" && aStep->IsFirstStepInVolume()) {
-    G4double edep = aStep->GetTotalEnergyDeposit();
-    if (edep <= 0.0) {
+  // Total energy deposit, weighted like G4PSEnergyDeposit
+  if (edep > 0.) {
+    if (channel < 0 || channel >= GetNumberOfChannels()) {
+      G4ExceptionDescription msg;
+      msg << "Copy number " << channel << " of "
+          << preStep->GetPhysicalVolume()->GetName()
+          << " is not a scintillator channel";
+      G4Exception("ScintillatorSD::ProcessHits()", "MyCode0006",
+                  FatalException, msg);
       return false;
     }
-    G4int ParentID       = theTrack->GetParentID();
-    G4int TrackID        = theTrack->GetTrackID();
-    G4double TrackLength = theTrack->GetTrackLength();
-    auto newHit          = new ScintillatorHit;
-    newHit->SetScintName(theTrack->GetVolume()->GetName().back());
-    newHit->SetParticleName(std::move(particleName));
-    newHit->SetParentId(ParentID);
-    newHit->SetTrId(TrackID);
-    newHit->SetEdep(edep);
-    newHit->SetE(theTrack->GetTotalEnergy());
-    newHit->SetPos(aStep->GetPostStepPoint()->GetPosition());
-    // Global time start from the start of the run
-    newHit->SetTime(aStep->GetPostStepPoint()->GetGlobalTime());
-    // Local time start from particle creation
-    // newHit->SetTime(aStep->GetPostStepPoint()->GetLocalTime());
-    newHit->SetTrLen(TrackLength + aStep->GetStepLength());
-    newHit->SetLocalTime(aStep->GetPostStepPoint()->GetGlobalTime());
-
-    fScintHitCollection->insert(newHit);
-
-    return true;
+    if (fDeposit[channel] == 0.) {
+      fTouched.push_back(channel);
+    }
+    fEdep[channel] += edep * preStep->GetWeight();
+    fDeposit[channel] += edep;
+    fFirstTime[channel] = std::min(fFirstTime[channel],
+                                   aStep->GetPostStepPoint()->GetGlobalTime());
+
+    if (fOpticalModel->IsEnabled()) {
+      const G4int npe = fOpticalModel->SamplePhotoelectrons(aStep, fPETimes);
+      fPhotoelectrons[channel] += npe;
+      fPEChannels.resize(fPETimes.size(), channel);
+    }
+  }
+
+  if (!fFilter->Accept(aStep, channel, edep)) {
+    return false;
   }
-  return false;
+
+  const G4Track* theTrack = aStep->GetTrack();
+  const auto* postStep    = aStep->GetPostStepPoint();
+  const auto& position    = postStep->GetPosition();
+
+  ScintillatorHit hit;
+  hit.detID        = channel;
+  hit.pdg          = theTrack->GetDefinition()->GetPDGEncoding();
+  hit.parentID     = theTrack->GetParentID();
+  hit.trackID      = theTrack->GetTrackID();
+  hit.nSecondaries = aStep->GetSecondaryInCurrentStep()->size();
+  hit.edep         = edep / MeV;
+  hit.energy       = theTrack->GetTotalEnergy() / MeV;
+  hit.pos[0]       = position.x();
+  hit.pos[1]       = position.y();
+  hit.pos[2]       = position.z();
+  // Global time start from the start of the run
+  hit.time        = postStep->GetGlobalTime() / ns;
+  hit.trackLength = theTrack->GetTrackLength() + aStep->GetStepLength();
+  hit.weight      = preStep->GetWeight();
+
+  fHitBuffer.Append(hit);
+
+  return true;
 }
 
 void ScintillatorSD::EndOfEvent(G4HCofThisEvent*) {}
@@ -0,0 +1,110 @@
+#include "StackingAction.hh"
+
+#include <G4Electron.hh>
+#include <G4LogicalVolume.hh>
+#include <G4OpticalPhoton.hh>
+#include <G4RegionStore.hh>
+#include <G4Track.hh>
+#include <G4VPhysicalVolume.hh>
+#include <Randomize.hh>
+
+StackingAction::StackingAction(const StackingPolicy* policy,
+                               RunAction* runAction)
+    : G4UserStackingAction(), fPolicy(policy), fRunAction(runAction),
+      fRegionsFound(false), fRegions()
+{
+}
+
+StackingAction::~StackingAction() {}
+
+void StackingAction::FindRegions()
+{
+  for (G4int i = 0; i < RegionSettings::kNRegions; ++i) {
+    fRegions[i] = G4RegionStore::GetInstance()->GetRegion(
+        RegionSettings::GetName(static_cast<RegionSettings::RegionIndex>(i)),
+        false);
+  }
+  fRegionsFound = true;
+}
+
+void StackingAction::CountSecondary(const G4LogicalVolume* lv)
+{
+  const auto* region = lv->GetRegion();
+  for (G4int i = 0; i < RegionSettings::kNRegions; ++i) {
+    if (region == fRegions[i]) {
+      fRunAction->CountSecondary(static_cast<RegionSettings::RegionIndex>(i));
+      return;
+    }
+  }
+}
+
+StackingPolicy::TrackClass StackingAction::Classify(const G4Track* track,
+                                                    const G4LogicalVolume* lv)
+{
+  const auto* particle = track->GetParticleDefinition();
+
+  // The scintillators are the only sensitive volumes
+  if (particle == G4OpticalPhoton::Definition()) {
+    if (lv->GetSensitiveDetector()) {
+      return StackingPolicy::kNTrackClasses;
+    }
+    return StackingPolicy::kOpticalOutsideScintillator;
+  }
+  // By region, whatever the volumes and materials of the geometry
+  const auto* region = lv->GetRegion();
+  if (particle == G4Electron::Definition() &&
+      region == fRegions[RegionSettings::kAbsorber] &&
+      track->GetKineticEnergy() < fPolicy->GetElectronThreshold()) {
+    return StackingPolicy::kAbsorberElectron;
+  }
+  if (region == fRegions[RegionSettings::kWorld]) {
+    return StackingPolicy::kInAir;
+  }
+  return StackingPolicy::kNTrackClasses;
+}
+
+G4ClassificationOfNewTrack
+StackingAction::ClassifyNewTrack(const G4Track* track)
+{
+  // Never touch the primaries
+  if (track->GetParentID() == 0) {
+    return fUrgent;
+  }
+
+  const auto* volume = track->GetVolume();
+  if (!volume) {
+    return fUrgent;
+  }
+  if (!fRegionsFound) {
+    FindRegions();
+  }
+
+  const auto* lv = volume->GetLogicalVolume();
+  CountSecondary(lv);
+
+  const auto trackClass = Classify(track, lv);
+  if (trackClass == StackingPolicy::kNTrackClasses) {
+    return fUrgent;
+  }
+
+  switch (fPolicy->GetAction(trackClass)) {
+  case StackingPolicy::kKill:
+    fRunAction->CountKilledTrack(trackClass, track->GetKineticEnergy());
+    return fKill;
+
+  case StackingPolicy::kRoulette: {
+    const G4double probability = fPolicy->GetSurvivalProbability(trackClass);
+    if (G4UniformRand() < probability) {
+      // The survivor carries the weight of the killed ones
+      const_cast<G4Track*>(track)->SetWeight(track->GetWeight() / probability);
+      fRunAction->CountSurvivedTrack(trackClass);
+      return fUrgent;
+    }
+    fRunAction->CountKilledTrack(trackClass, track->GetKineticEnergy());
+    return fKill;
+  }
+
+  default:
+    return fUrgent;
+  }
+}
@@ -0,0 +1,115 @@
+#include "StackingPolicy.hh"
+
+#include <G4Exception.hh>
+#include <G4GenericMessenger.hh>
+#include <G4SystemOfUnits.hh>
+
+#include <sstream>
+
+StackingPolicy::StackingPolicy()
+    : fMessenger(nullptr), fElectronThreshold(1. * MeV)
+{
+  // Nothing outside the scintillators detects optical photons and the
+  // absorber electrons below 1 MeV never leave the iron. Delta rays in air
+  // can reach a scintillator, so they are kept.
+  fAction[kOpticalOutsideScintillator] = kKill;
+  fAction[kAbsorberElectron]           = kKill;
+  fAction[kInAir]                      = kKeep;
+  for (auto& probability : fSurvivalProbability) {
+    probability = 1.;
+  }
+
+  DefineCommands();
+}
+
+StackingPolicy::~StackingPolicy() { delete fMessenger; }
+
+const char* StackingPolicy::GetClassName(TrackClass trackClass)
+{
+  switch (trackClass) {
+  case kOpticalOutsideScintillator:
+    return "optical photons outside scintillators";
+  case kAbsorberElectron:
+    return "low energy electrons in the absorber";
+  case kInAir:
+    return "tracks in air";
+  default:
+    return "unknown";
+  }
+}
+
+void StackingPolicy::SetOpticalPolicy(const G4String& policy)
+{
+  SetPolicy(kOpticalOutsideScintillator, policy);
+}
+
+void StackingPolicy::SetAbsorberElectronPolicy(const G4String& policy)
+{
+  SetPolicy(kAbsorberElectron, policy);
+}
+
+void StackingPolicy::SetAirPolicy(const G4String& policy)
+{
+  SetPolicy(kInAir, policy);
+}
+
+void StackingPolicy::SetPolicy(TrackClass trackClass, const G4String& policy)
+{
+  std::istringstream is(policy);
+  std::string action;
+  G4double probability = 1.;
+  is >> action;
+
+  if (action == "keep") {
+    fAction[trackClass] = kKeep;
+  } else if (action == "kill") {
+    fAction[trackClass] = kKill;
+  } else if (action == "roulette" && (is >> probability) && probability > 0. &&
+             probability <= 1.) {
+    fAction[trackClass]              = kRoulette;
+    fSurvivalProbability[trackClass] = probability;
+  } else {
+    G4ExceptionDescription msg;
+    msg << "Invalid stacking policy \"" << policy << "\" for "
+        << GetClassName(trackClass) << G4endl;
+    msg << "Use keep, kill or roulette <probability in (0,1]>";
+    G4Exception("StackingPolicy::SetPolicy()", "MyCode0009", JustWarning,
+                msg);
+  }
+}
+
+void StackingPolicy::DefineCommands()
+{
+  fMessenger = new G4GenericMessenger(this, "/muon_lab/stack/",
+                                      "Stacking of secondary tracks");
+
+  // The workers read this object directly, nothing to broadcast
+  auto& opticalCmd = fMessenger->DeclareMethod(
+      "optical", &StackingPolicy::SetOpticalPolicy,
+      "Optical photons outside scintillators: keep, kill or roulette <p>");
+  opticalCmd.SetParameterName("policy", false);
+  opticalCmd.SetStates(G4State_PreInit, G4State_Idle);
+  opticalCmd.command->SetToBeBroadcasted(false);
+
+  auto& absorberCmd = fMessenger->DeclareMethod(
+      "absorberElectron", &StackingPolicy::SetAbsorberElectronPolicy,
+      "Electrons below threshold in the absorber: keep, kill or roulette <p>");
+  absorberCmd.SetParameterName("policy", false);
+  absorberCmd.SetStates(G4State_PreInit, G4State_Idle);
+  absorberCmd.command->SetToBeBroadcasted(false);
+
+  auto& airCmd = fMessenger->DeclareMethod(
+      "air", &StackingPolicy::SetAirPolicy,
+      "Secondaries born in air: keep, kill or roulette <p>");
+  airCmd.SetParameterName("policy", false);
+  airCmd.SetStates(G4State_PreInit, G4State_Idle);
+  airCmd.command->SetToBeBroadcasted(false);
+
+  auto& thresholdCmd = fMessenger->DeclarePropertyWithUnit(
+      "electronThreshold", "MeV", fElectronThreshold,
+      "Kinetic energy below which absorber electrons are handled");
+  thresholdCmd.SetParameterName("ekin", false);
+  thresholdCmd.SetRange("ekin>=0.");
+  thresholdCmd.SetStates(G4State_PreInit, G4State_Idle);
+  thresholdCmd.command->SetToBeBroadcasted(false);
+}
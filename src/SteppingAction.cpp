@@ -0,0 +1,24 @@
+#include "SteppingAction.hh"
+
+#include <G4OpticalPhoton.hh>
+#include <G4Step.hh>
+#include <G4Track.hh>
+
+SteppingAction::SteppingAction(VoxelScorer* scorer)
+    : G4UserSteppingAction(), fScorer(scorer)
+{
+}
+
+SteppingAction::~SteppingAction() {}
+
+void SteppingAction::UserSteppingAction(const G4Step* step)
+{
+  if (!fScorer->IsActive() ||
+      step->GetTrack()->GetDefinition() == G4OpticalPhoton::Definition()) {
+    return;
+  }
+  const auto* preStep = step->GetPreStepPoint();
+  fScorer->Score(preStep->GetPosition(),
+                 step->GetPostStepPoint()->GetPosition(),
+                 step->GetTotalEnergyDeposit(), preStep->GetWeight());
+}
@@ -0,0 +1,90 @@
+#include "TrackingAction.hh"
+#include "ScintillatorSD.hh"
+
+#include <G4Event.hh>
+#include <G4Neutron.hh>
+#include <G4ParticleDefinition.hh>
+#include <G4PrimaryParticle.hh>
+#include <G4PrimaryVertex.hh>
+#include <G4RunManager.hh>
+#include <G4SDManager.hh>
+#include <G4SystemOfUnits.hh>
+#include <G4Track.hh>
+#include <G4TrackingManager.hh>
+
+namespace {
+// Largest energy of the gammas of a neutron capture
+const G4double kCaptureEnergy = 10. * MeV;
+} // namespace
+
+TrackingAction::TrackingAction(const CoincidenceTrigger* trigger)
+    : G4UserTrackingAction(), fTrigger(trigger), fScintillatorSD(nullptr),
+      fBudget(0.)
+{
+}
+
+TrackingAction::~TrackingAction() {}
+
+G4double TrackingAction::ReleasableEnergy(const G4ParticleDefinition* particle,
+                                          G4double ekin)
+{
+  const G4double mass = particle->GetPDGMass();
+  // Antiparticles annihilate with a partner of the same mass
+  if (particle->GetPDGEncoding() < 0) {
+    return ekin + 2. * mass;
+  }
+  // Decays within the event, not the neutron's, which is captured
+  if (particle == G4Neutron::Definition()) {
+    return ekin + kCaptureEnergy;
+  }
+  if (!particle->GetPDGStable() && particle->GetPDGLifeTime() < 1. * ms) {
+    return ekin + mass;
+  }
+  return ekin;
+}
+
+void TrackingAction::BeginEvent(const G4Event* event)
+{
+  fBudget = 0.;
+  if (!fTrigger->IsEarlyAbortEnabled()) {
+    return;
+  }
+  for (G4int i = 0; i < event->GetNumberOfPrimaryVertex(); ++i) {
+    for (auto* primary = event->GetPrimaryVertex(i)->GetPrimary(); primary;
+         primary = primary->GetNext()) {
+      if (primary->GetG4code()) {
+        fBudget += ReleasableEnergy(primary->GetG4code(),
+                                    primary->GetKineticEnergy());
+      }
+    }
+  }
+}
+
+void TrackingAction::PreUserTrackingAction(const G4Track* track)
+{
+  if (!fTrigger->IsEarlyAbortEnabled()) {
+    return;
+  }
+  fBudget -=
+      ReleasableEnergy(track->GetDefinition(), track->GetKineticEnergy());
+}
+
+void TrackingAction::PostUserTrackingAction(const G4Track*)
+{
+  if (!fTrigger->IsEarlyAbortEnabled()) {
+    return;
+  }
+  for (const auto* secondary : *fpTrackingManager->GimmeSecondaries()) {
+    fBudget += ReleasableEnergy(secondary->GetDefinition(),
+                                secondary->GetKineticEnergy());
+  }
+
+  if (!fScintillatorSD) {
+    fScintillatorSD = static_cast<ScintillatorSD*>(
+        G4SDManager::GetSDMpointer()->FindSensitiveDetector("scintillators"));
+  }
+  // With a margin for the rounding of the budget
+  if (!fTrigger->IsReachable(*fScintillatorSD, fBudget * 1.001 + 1. * keV)) {
+    G4RunManager::GetRunManager()->AbortEvent();
+  }
+}
@@ -0,0 +1,373 @@
+#include "VoxelScoring.hh"
+#include "VoxelFormat.hh"
+
+#include <G4Exception.hh>
+#include <G4GenericMessenger.hh>
+#include <G4LogicalVolume.hh>
+#include <G4Navigator.hh>
+#include <G4SystemOfUnits.hh>
+#include <G4TransportationManager.hh>
+#include <G4VPhysicalVolume.hh>
+#include <G4VSolid.hh>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+namespace {
+// Bins merged at a time, the chunk of the total stays in the cache while
+// the chunks of the other threads stream through
+const std::size_t kMergeChunk = 1 << 13;
+
+void Add(G4double* __restrict total, const G4double* __restrict values,
+         std::size_t n)
+{
+  for (std::size_t i = 0; i < n; ++i) {
+    total[i] += values[i];
+  }
+}
+} // namespace
+
+VoxelScorer::VoxelScorer()
+    : fGrid(), fEdep(nullptr), fLength(nullptr), fNext(nullptr)
+{
+}
+
+VoxelScorer::~VoxelScorer()
+{
+  std::free(fEdep);
+  std::free(fLength);
+}
+
+void VoxelScorer::Reset(const VoxelGrid& grid)
+{
+  std::free(fEdep);
+  std::free(fLength);
+  fEdep   = nullptr;
+  fLength = nullptr;
+  fGrid   = grid;
+  fNext   = nullptr;
+
+  const std::size_t nBins = grid.GetNumberOfBins();
+  if (nBins == 0) {
+    return;
+  }
+  fEdep   = static_cast<G4double*>(std::calloc(nBins, sizeof(G4double)));
+  fLength = static_cast<G4double*>(std::calloc(nBins, sizeof(G4double)));
+  if (!fEdep || !fLength) {
+    G4ExceptionDescription msg;
+    msg << "Cannot allocate the " << nBins << " voxels of the scoring grid";
+    G4Exception("VoxelScorer::Reset()", "MyCode0022", FatalException, msg);
+  }
+}
+
+void VoxelScorer::Score(const G4ThreeVector& start, const G4ThreeVector& end,
+                        G4double edep, G4double weight)
+{
+  const auto& grid = fGrid;
+  const auto index = [&grid](const G4int cell[3]) {
+    return cell[0] +
+           std::size_t(grid.bins[0]) *
+               (cell[1] + std::size_t(grid.bins[1]) * cell[2]);
+  };
+
+  if (edep > 0.) {
+    const G4ThreeVector middle = 0.5 * (start + end);
+    G4int cell[3];
+    G4bool inside = true;
+    for (G4int k = 0; k < 3 && inside; ++k) {
+      const G4double x = (middle[k] - grid.lower[k]) * grid.invWidth[k];
+      cell[k]          = static_cast<G4int>(std::floor(x));
+      inside           = x >= 0. && cell[k] < grid.bins[k];
+    }
+    if (inside) {
+      fEdep[index(cell)] += edep * weight;
+    }
+  }
+
+  const G4ThreeVector direction = end - start;
+  const G4double length         = direction.mag();
+  if (length <= 0.) {
+    return;
+  }
+
+  // Part of the step inside the grid, in fractions of the step
+  G4double t0 = 0.;
+  G4double t1 = 1.;
+  for (G4int k = 0; k < 3; ++k) {
+    if (direction[k] == 0.) {
+      if (start[k] < grid.lower[k] || start[k] >= grid.upper[k]) {
+        return;
+      }
+      continue;
+    }
+    G4double ta = (grid.lower[k] - start[k]) / direction[k];
+    G4double tb = (grid.upper[k] - start[k]) / direction[k];
+    if (ta > tb) {
+      std::swap(ta, tb);
+    }
+    t0 = std::max(t0, ta);
+    t1 = std::min(t1, tb);
+  }
+  if (t0 >= t1) {
+    return;
+  }
+
+  // Walk the voxels crossed by the step, the next boundary along every
+  // axis is tMax and the voxel width is tDelta, in fractions of the step
+  G4int cell[3], step[3];
+  G4double tMax[3], tDelta[3];
+  for (G4int k = 0; k < 3; ++k) {
+    const G4double width = 1. / grid.invWidth[k];
+    const G4double x =
+        (start[k] + t0 * direction[k] - grid.lower[k]) * grid.invWidth[k];
+    cell[k] =
+        std::min(std::max(static_cast<G4int>(std::floor(x)), 0),
+                 grid.bins[k] - 1);
+    if (direction[k] > 0.) {
+      step[k] = 1;
+      tMax[k] =
+          (grid.lower[k] + (cell[k] + 1) * width - start[k]) / direction[k];
+      tDelta[k] = width / direction[k];
+    } else if (direction[k] < 0.) {
+      step[k]   = -1;
+      tMax[k]   = (grid.lower[k] + cell[k] * width - start[k]) / direction[k];
+      tDelta[k] = -width / direction[k];
+    } else {
+      step[k]   = 0;
+      tMax[k]   = DBL_MAX;
+      tDelta[k] = DBL_MAX;
+    }
+  }
+
+  const G4double scale = length * weight;
+  for (G4double t = t0;;) {
+    const G4int axis = tMax[0] < tMax[1] ? (tMax[0] < tMax[2] ? 0 : 2)
+                                         : (tMax[1] < tMax[2] ? 1 : 2);
+    const G4double next = std::min(tMax[axis], t1);
+    fLength[index(cell)] += std::max(next - t, 0.) * scale;
+    cell[axis] += step[axis];
+    if (next >= t1 || cell[axis] < 0 || cell[axis] >= grid.bins[axis]) {
+      break;
+    }
+    t = next;
+    tMax[axis] += tDelta[axis];
+  }
+}
+
+VoxelScoring::VoxelScoring()
+    : fMessenger(nullptr), fEnabled(false), fVolume("World"),
+      fFileName("voxels"), fBins{100, 100, 100}, fGrid(),
+      fPublished(nullptr)
+{
+  DefineCommands();
+}
+
+VoxelScoring::~VoxelScoring() { delete fMessenger; }
+
+void VoxelScoring::BeginOfRun()
+{
+  fGrid      = VoxelGrid();
+  fPublished = nullptr;
+  if (!fEnabled) {
+    return;
+  }
+
+  // The world or one of its daughters
+  const G4VPhysicalVolume* volume = G4TransportationManager::
+      GetTransportationManager()->GetNavigatorForTracking()->GetWorldVolume();
+  if (volume && volume->GetName() != fVolume) {
+    const auto* worldLV = volume->GetLogicalVolume();
+    volume              = nullptr;
+    for (G4int i = 0; i < worldLV->GetNoDaughters(); ++i) {
+      if (worldLV->GetDaughter(i)->GetName() == fVolume) {
+        volume = worldLV->GetDaughter(i);
+        break;
+      }
+    }
+  }
+  if (!volume) {
+    G4ExceptionDescription msg;
+    msg << "No volume " << fVolume << " in the world, nothing is scored";
+    G4Exception("VoxelScoring::BeginOfRun()", "MyCode0022", JustWarning, msg);
+    return;
+  }
+
+  // Axis aligned box around the volume in the world frame
+  G4ThreeVector pMin, pMax;
+  volume->GetLogicalVolume()->GetSolid()->BoundingLimits(pMin, pMax);
+  const auto rotation    = volume->GetObjectRotationValue();
+  const auto translation = volume->GetObjectTranslation();
+  for (G4int k = 0; k < 3; ++k) {
+    fGrid.lower[k] = DBL_MAX;
+    fGrid.upper[k] = -DBL_MAX;
+  }
+  for (G4int c = 0; c < 8; ++c) {
+    G4ThreeVector corner((c & 1) ? pMax.x() : pMin.x(),
+                         (c & 2) ? pMax.y() : pMin.y(),
+                         (c & 4) ? pMax.z() : pMin.z());
+    corner = rotation * corner + translation;
+    for (G4int k = 0; k < 3; ++k) {
+      fGrid.lower[k] = std::min(fGrid.lower[k], corner[k]);
+      fGrid.upper[k] = std::max(fGrid.upper[k], corner[k]);
+    }
+  }
+  for (G4int k = 0; k < 3; ++k) {
+    fGrid.bins[k]     = fBins[k];
+    fGrid.invWidth[k] = fBins[k] / (fGrid.upper[k] - fGrid.lower[k]);
+  }
+
+  G4cout << "INFO: voxel scoring of " << fVolume << ", " << fBins[0] << " x "
+         << fBins[1] << " x " << fBins[2] << " voxels" << G4endl;
+}
+
+void VoxelScoring::Publish(VoxelScorer* scorer)
+{
+  VoxelScorer* head = fPublished.load(std::memory_order_relaxed);
+  do {
+    scorer->fNext = head;
+  } while (!fPublished.compare_exchange_weak(head, scorer,
+                                             std::memory_order_release,
+                                             std::memory_order_relaxed));
+}
+
+void VoxelScoring::EndOfRun(G4int run, G4int nEvents)
+{
+  std::vector<VoxelScorer*> scorers;
+  for (auto* scorer = fPublished.exchange(nullptr, std::memory_order_acquire);
+       scorer; scorer = scorer->fNext) {
+    scorers.push_back(scorer);
+  }
+  if (scorers.empty()) {
+    return;
+  }
+
+  // Summed into the first scorer, which is reset at the next run
+  auto* total             = scorers.front();
+  const std::size_t nBins = fGrid.GetNumberOfBins();
+  for (std::size_t begin = 0; begin < nBins; begin += kMergeChunk) {
+    const std::size_t n = std::min(kMergeChunk, nBins - begin);
+    for (std::size_t i = 1; i < scorers.size(); ++i) {
+      Add(total->fEdep + begin, scorers[i]->fEdep + begin, n);
+      Add(total->fLength + begin, scorers[i]->fLength + begin, n);
+    }
+  }
+
+  Write(*total, run, nEvents);
+}
+
+void VoxelScoring::Write(const VoxelScorer& total, G4int run,
+                         G4int nEvents) const
+{
+  const std::size_t nBins = fGrid.GetNumberOfBins();
+  const G4double* edep    = total.fEdep;
+  const G4double* length  = total.fLength;
+  u64 nFilled             = 0;
+  for (std::size_t i = 0; i < nBins; ++i) {
+    nFilled += edep[i] != 0. || length[i] != 0.;
+  }
+
+  voxel::FileHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, voxel::kFileMagic, sizeof(header.magic));
+  header.version = voxel::kVersion;
+  header.sparse  = voxel::SparseSize(nFilled) < voxel::DenseSize(nBins);
+  header.run     = run;
+  header.nEvents = nEvents;
+  header.nFilled = nFilled;
+  for (G4int k = 0; k < 3; ++k) {
+    header.bins[k]  = fGrid.bins[k];
+    header.lower[k] = fGrid.lower[k] / mm;
+    header.upper[k] = fGrid.upper[k] / mm;
+  }
+
+  std::ostringstream path;
+  path << fFileName << "_run" << run << ".vox";
+  std::ofstream file(path.str(), std::ios::binary);
+  file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  if (header.sparse) {
+    std::vector<u64> bins;
+    std::vector<f64> edeps, lengths;
+    bins.reserve(nFilled);
+    edeps.reserve(nFilled);
+    lengths.reserve(nFilled);
+    for (std::size_t i = 0; i < nBins; ++i) {
+      if (edep[i] != 0. || length[i] != 0.) {
+        bins.push_back(i);
+        edeps.push_back(edep[i] / MeV);
+        lengths.push_back(length[i] / mm);
+      }
+    }
+    file.write(reinterpret_cast<const char*>(bins.data()),
+               nFilled * sizeof(u64));
+    file.write(reinterpret_cast<const char*>(edeps.data()),
+               nFilled * sizeof(f64));
+    file.write(reinterpret_cast<const char*>(lengths.data()),
+               nFilled * sizeof(f64));
+  } else {
+    // Internal units are MeV and mm
+    file.write(reinterpret_cast<const char*>(edep), nBins * sizeof(f64));
+    file.write(reinterpret_cast<const char*>(length), nBins * sizeof(f64));
+  }
+
+  if (!file) {
+    G4ExceptionDescription msg;
+    msg << "Cannot write the voxel scoring file " << path.str();
+    G4Exception("VoxelScoring::Write()", "MyCode0022", JustWarning, msg);
+    return;
+  }
+  G4cout << "INFO: " << nFilled << " of " << nBins << " voxels written to "
+         << path.str() << G4endl;
+}
+
+void VoxelScoring::SetBins(const G4String& bins)
+{
+  std::istringstream is(bins);
+  G4int n[3] = {0, 0, 0};
+  is >> n[0] >> n[1] >> n[2];
+  if (is.fail() || n[0] < 1 || n[1] < 1 || n[2] < 1) {
+    G4ExceptionDescription msg;
+    msg << "Invalid voxel bins \"" << bins << "\", use <nx> <ny> <nz>";
+    G4Exception("VoxelScoring::SetBins()", "MyCode0022", JustWarning, msg);
+    return;
+  }
+  std::copy(n, n + 3, fBins);
+}
+
+void VoxelScoring::DefineCommands()
+{
+  fMessenger = new G4GenericMessenger(this, "/muon_lab/scoring/",
+                                      "Voxel scoring of the energy deposit "
+                                      "and track length");
+
+  // The workers read this object directly, nothing to broadcast
+  auto& enableCmd = fMessenger->DeclareProperty(
+      "enable", fEnabled, "Score the energy deposit and track length");
+  enableCmd.SetParameterName("flag", false);
+  enableCmd.SetStates(G4State_PreInit, G4State_Idle);
+  enableCmd.command->SetToBeBroadcasted(false);
+
+  auto& binsCmd = fMessenger->DeclareMethod(
+      "bins", &VoxelScoring::SetBins, "Number of voxels: <nx> <ny> <nz>");
+  binsCmd.SetParameterName("bins", false);
+  binsCmd.SetStates(G4State_PreInit, G4State_Idle);
+  binsCmd.command->SetToBeBroadcasted(false);
+
+  auto& volumeCmd = fMessenger->DeclareProperty(
+      "volume", fVolume,
+      "Physical volume covered by the grid, the world or a daughter");
+  volumeCmd.SetParameterName("name", false);
+  volumeCmd.SetStates(G4State_PreInit, G4State_Idle);
+  volumeCmd.command->SetToBeBroadcasted(false);
+
+  auto& fileCmd = fMessenger->DeclareProperty(
+      "fileName", fFileName, "Prefix of the voxel scoring files");
+  fileCmd.SetParameterName("name", false);
+  fileCmd.SetStates(G4State_PreInit, G4State_Idle);
+  fileCmd.command->SetToBeBroadcasted(false);
+}
@@ -0,0 +1,288 @@
+// Merges the per-thread columnar files of muon_lab into one file.
+//
+// The event index of the inputs is read first and decides where every
+// event goes in the output, so the blocks of the output are laid out
+// before any hit is copied. The copies, one job per output block and
+// column, then run on all the cores straight into the mapped output.
+//
+//   muon_lab_merge -o merged.mlc [-s] [-j threads] hits_run0_t*.mlc
+
+#include "ColumnarFormat.hh"
+#include "pft.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+using namespace columnar;
+
+// Where the rows of one event are found in the inputs
+struct EventRef {
+  i64 event;
+  f64 weight;
+  u32 file;
+  u32 block;
+  u64 rowBegin;
+  u64 rowEnd;
+};
+
+// Events [eventBegin, eventEnd) of the merged order
+struct OutputBlock {
+  u64 eventBegin;
+  u64 eventEnd;
+  u64 nRows;
+  u64 offset;
+  u64 size;
+  std::vector<u64> columnOffsets;
+};
+
+void PrintUsage(pft::AParse& parser)
+{
+  fprintf(stderr, " How to use the program: \n");
+  fprintf(stderr, " muon_lab_merge -o output [-s] [-j threads] [-r rows] "
+                  "inputs...\n");
+  parser.PrintUsage();
+}
+
+// Integer value of a command line flag, false if it is not a number
+bool ToInteger(const std::string& value, long& result)
+{
+  char* end = nullptr;
+  result    = std::strtol(value.c_str(), &end, 10);
+  return !value.empty() && *end == '\0';
+}
+
+bool SameColumns(const MappedFile& a, const MappedFile& b)
+{
+  if (a.Header().nColumns != b.Header().nColumns) {
+    return false;
+  }
+  for (u32 c = 0; c < a.Header().nColumns; ++c) {
+    if (a.Columns()[c].field != b.Columns()[c].field) {
+      return false;
+    }
+  }
+  return true;
+}
+} // namespace
+
+int main(int argc, char* argv[])
+{
+  pft::AParse parser(argc, argv);
+  parser.Add({"-o", "--output", "merged file", true});
+  parser.Add({"-s", "--sort", "order the events by event index", false});
+  parser.Add({"-j", "--threads", "copy threads, all cores by default", true});
+  parser.Add({"-r", "--rows", "hits per output block, 65536 by default",
+              true});
+  parser.Add({"-h", "--help", "print this message", false});
+
+  // hardware_concurrency is 0 when it cannot be told
+  long threads   = std::max(1u, std::thread::hardware_concurrency());
+  long blockRows = 1 << 16;
+  if (!parser.Parse() || parser.has("-h") || !parser.has("-o") ||
+      parser.positional.empty() ||
+      (parser.has("-j") && !ToInteger(parser.value_of("-j").unwrap, threads)) ||
+      (parser.has("-r") &&
+       !ToInteger(parser.value_of("-r").unwrap, blockRows)) ||
+      threads < 1 || blockRows < 1) {
+    PrintUsage(parser);
+    return parser.has("-h") ? 0 : 1;
+  }
+  const std::string output = parser.value_of("-o").unwrap;
+
+  // The output replaces its path only at the end, an input would be lost
+  struct stat outStat;
+  const bool outExists = ::stat(output.c_str(), &outStat) == 0;
+
+  // Inputs
+  std::vector<MappedFile> inputs(parser.positional.size());
+  for (std::size_t i = 0; i < inputs.size(); ++i) {
+    struct stat inStat;
+    if (outExists && ::stat(parser.positional[i].c_str(), &inStat) == 0 &&
+        inStat.st_dev == outStat.st_dev && inStat.st_ino == outStat.st_ino) {
+      fprintf(stderr, " The output %s is also an input\n", output.c_str());
+      return 1;
+    }
+    if (!inputs[i].Open(parser.positional[i])) {
+      fprintf(stderr, " Cannot read %s, not a complete columnar file\n",
+              parser.positional[i].c_str());
+      return 1;
+    }
+    if (!SameColumns(inputs[0], inputs[i])) {
+      fprintf(stderr, " %s does not have the columns of %s\n",
+              parser.positional[i].c_str(), parser.positional[0].c_str());
+      return 1;
+    }
+  }
+  const auto& header = inputs[0].Header();
+  const u32 nColumns = header.nColumns;
+
+  // Unified event index
+  std::vector<std::vector<MappedFile::Block>> blocks(inputs.size());
+  std::vector<EventRef> events;
+  for (u32 f = 0; f < inputs.size(); ++f) {
+    for (u64 b = 0; b < inputs[f].NumBlocks(); ++b) {
+      blocks[f].push_back(inputs[f].GetBlock(b));
+      const auto& block = blocks[f].back();
+      for (u64 e = 0; e < block.header->nEvents; ++e) {
+        events.push_back({block.event[e], block.weight[e], f, u32(b),
+                          e > 0 ? block.hitEnd[e - 1] : 0, block.hitEnd[e]});
+      }
+    }
+  }
+  if (parser.has("-s")) {
+    std::stable_sort(events.begin(), events.end(),
+                     [](const EventRef& a, const EventRef& b) {
+                       return a.event < b.event;
+                     });
+  }
+
+  // Output layout, blocks of at least blockRows hits as in ColumnarWriter
+  u64 offset = sizeof(FileHeader) + nColumns * sizeof(ColumnDesc);
+  std::vector<OutputBlock> outBlocks;
+  for (u64 e = 0; e < events.size();) {
+    OutputBlock block{e, e, 0, offset, 0, {}};
+    while (block.eventEnd < events.size() && block.nRows < u64(blockRows)) {
+      const auto& ref = events[block.eventEnd++];
+      block.nRows += ref.rowEnd - ref.rowBegin;
+    }
+    const u64 nEvents = block.eventEnd - block.eventBegin;
+    offset += sizeof(BlockHeader) +
+              nEvents * (sizeof(i64) + sizeof(f64) + sizeof(u64));
+    for (u32 c = 0; c < nColumns; ++c) {
+      block.columnOffsets.push_back(offset);
+      offset += Padded(block.nRows * TypeSize(inputs[0].Columns()[c].type));
+    }
+    block.size = offset - block.offset;
+    e          = block.eventEnd;
+    outBlocks.push_back(std::move(block));
+  }
+  const u64 indexOffset = offset;
+  const u64 fileSize    = indexOffset +
+                       outBlocks.size() * sizeof(BlockIndexEntry) +
+                       sizeof(Trailer);
+
+  // Written next to the output and renamed once complete, a failed merge
+  // leaves no truncated file behind
+  const std::string tmpName = output + ".tmp";
+  const int fd = ::open(tmpName.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0 || ::ftruncate(fd, fileSize) != 0) {
+    fprintf(stderr, " Cannot create %s\n", tmpName.c_str());
+    if (fd >= 0) {
+      ::close(fd);
+      ::unlink(tmpName.c_str());
+    }
+    return 1;
+  }
+  void* mapped =
+      ::mmap(nullptr, fileSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (mapped == MAP_FAILED) {
+    fprintf(stderr, " Cannot map %s\n", tmpName.c_str());
+    ::unlink(tmpName.c_str());
+    return 1;
+  }
+  auto* out = static_cast<u8*>(mapped);
+
+  // The file header and the run of the inputs, -1 if they differ
+  auto* outHeader   = reinterpret_cast<FileHeader*>(out);
+  *outHeader        = header;
+  outHeader->thread = -1;
+  for (const auto& input : inputs) {
+    if (input.Header().run != header.run) {
+      outHeader->run = -1;
+    }
+  }
+  std::copy(inputs[0].Columns(), inputs[0].Columns() + nColumns,
+            reinterpret_cast<ColumnDesc*>(out + sizeof(FileHeader)));
+
+  // Job c < nColumns copies column c of a block, job nColumns writes the
+  // block header and the per-event arrays
+  const u64 jobsPerBlock = nColumns + 1;
+  const u64 nJobs        = outBlocks.size() * jobsPerBlock;
+  std::atomic<u64> nextJob(0);
+  auto copy = [&]() {
+    for (u64 job = nextJob++; job < nJobs; job = nextJob++) {
+      const auto& block = outBlocks[job / jobsPerBlock];
+      const u32 c       = job % jobsPerBlock;
+      if (c == nColumns) {
+        const u64 nEvents = block.eventEnd - block.eventBegin;
+        auto* blockHeader = reinterpret_cast<BlockHeader*>(out + block.offset);
+        blockHeader->magic    = kBlockMagic;
+        blockHeader->nColumns = nColumns;
+        blockHeader->nRows    = block.nRows;
+        blockHeader->nEvents  = nEvents;
+        blockHeader->size     = block.size;
+        auto* event  = reinterpret_cast<i64*>(blockHeader + 1);
+        auto* weight = reinterpret_cast<f64*>(event + nEvents);
+        auto* hitEnd = reinterpret_cast<u64*>(weight + nEvents);
+        u64 rows     = 0;
+        for (u64 e = 0; e < nEvents; ++e) {
+          const auto& ref = events[block.eventBegin + e];
+          rows += ref.rowEnd - ref.rowBegin;
+          event[e]  = ref.event;
+          weight[e] = ref.weight;
+          hitEnd[e] = rows;
+        }
+        continue;
+      }
+      const std::size_t size = TypeSize(inputs[0].Columns()[c].type);
+      u8* dest               = out + block.columnOffsets[c];
+      for (u64 e = block.eventBegin; e < block.eventEnd; ++e) {
+        const auto& ref = events[e];
+        const auto* src =
+            static_cast<const u8*>(blocks[ref.file][ref.block].columns[c]);
+        const u64 bytes = (ref.rowEnd - ref.rowBegin) * size;
+        std::memcpy(dest, src + ref.rowBegin * size, bytes);
+        dest += bytes;
+      }
+    }
+  };
+  std::vector<std::thread> workers;
+  for (long i = 1; i < std::min<long>(threads, nJobs); ++i) {
+    workers.emplace_back(copy);
+  }
+  copy();
+  for (auto& worker : workers) {
+    worker.join();
+  }
+
+  // Footer index
+  auto* index = reinterpret_cast<BlockIndexEntry*>(out + indexOffset);
+  for (std::size_t b = 0; b < outBlocks.size(); ++b) {
+    const auto& block = outBlocks[b];
+    index[b] = {block.offset, block.nRows, block.eventEnd - block.eventBegin,
+                events[block.eventBegin].event};
+  }
+  auto* trailer        = reinterpret_cast<Trailer*>(index + outBlocks.size());
+  trailer->nBlocks     = outBlocks.size();
+  trailer->indexOffset = indexOffset;
+  std::memcpy(trailer->magic, kTrailerMagic, sizeof(trailer->magic));
+
+  const bool synced = ::msync(out, fileSize, MS_SYNC) == 0;
+  ::munmap(out, fileSize);
+  if (!synced || ::rename(tmpName.c_str(), output.c_str()) != 0) {
+    fprintf(stderr, " Write error on %s\n", output.c_str());
+    ::unlink(tmpName.c_str());
+    return 1;
+  }
+
+  u64 nRows = 0;
+  for (const auto& block : outBlocks) {
+    nRows += block.nRows;
+  }
+  printf(" %zu files, %zu events, %lu hits in %zu blocks -> %s\n",
+         inputs.size(), events.size(), static_cast<unsigned long>(nRows),
+         outBlocks.size(), output.c_str());
+  return 0;
+}